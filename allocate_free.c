@@ -1,76 +1,368 @@
 #include <stdio.h>
 
 #include "biqbin.h"
-#include "global_var.h"
 
-extern BabSolution *BabSol;     // global solution of B&B algorithm defined in heap.c
-
-void allocMemory(void) {
+void allocMemory(BiqBinContext *ctx) {
 
     /* 
-     * SP, SP->n, SP->L, PP, PP->n and PP->L 
-     * are all allocated and defined in readData (process_input.c),
-     * before this function is called
+     * SP, SP->n and SP->L are allocated and defined in 
+     * processAdjMatrixSetPP_SP (process_input.c), before this function is called.
+     * Every B&B worker calls this function to allocate its own bounding workspace.
      */
 
-    int N = SP->n;
+    const BiqBinParameters *params = &ctx->tree->params;
+    int N = ctx->tree->SP->n;
+
+    /* subproblem */
+    alloc(ctx->PP, Problem);
+    ctx->PP->n = N;
+    alloc_matrix(ctx->PP->L, N, double);
+    alloc_vector(ctx->PP_vars, N, int);
+
+    /* workspace of ipm_mc_pk and fct_eval */
+    IPMWorkspace *ws;
+    alloc(ws, IPMWorkspace);
+    alloc_matrix(ws->Z, N, double);
+    alloc_matrix(ws->dX, N, double);
+    alloc_matrix(ws->dX1, N, double);
+    alloc_matrix(ws->Zi, N, double);
+    alloc_matrix(ws->M, N, double);
+    alloc_matrix(ws->tmp, N, double);
+    alloc_matrix(ws->tmp2, N, double);
+    alloc_vector(ws->dy, N, double);
+    alloc_vector(ws->dy1, N, double);
+    alloc_vector(ws->b, N, double);
+    alloc_matrix(ws->L0, N, double);
+    ws->lwork = 26 * N;
+    ws->liwork = 10 * N;
+    alloc_vector(ws->work, ws->lwork, double);
+    alloc_vector(ws->iwork, ws->liwork, int);
+
+    ws->mixed = params->ipm_mixed_precision;
+    if (ws->mixed) {
+        alloc_matrix(ws->sL, N, float);
+        alloc_matrix(ws->sX, N, float);
+        alloc_matrix(ws->sZ, N, float);
+        alloc_matrix(ws->sZi, N, float);
+        alloc_matrix(ws->sM, N, float);
+        alloc_matrix(ws->sdX, N, float);
+        alloc_matrix(ws->sdX1, N, float);
+        alloc_matrix(ws->stmp, N, float);
+        alloc_vector(ws->sy, N, float);
+        alloc_vector(ws->sdy, N, float);
+        alloc_vector(ws->sdy1, N, float);
+    }
+    ctx->ipm_ws = ws;
+
+    /* workspace of lambda_eta and solve_lambda */
+    QPWorkspace *qp;
+    alloc(qp, QPWorkspace);
+    alloc_matrix(qp->GtG, MaxBundle, double);
+    alloc_vector(qp->cols, MaxBundle, int);
+    alloc_vector(qp->rows, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, int);
+    alloc_vector(qp->prev, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, int);
+    alloc_vector(qp->col, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_matrix(qp->K, MaxBundle + 1, double);
+    alloc_vector(qp->c, MaxBundle, double);
+    alloc_vector(qp->zeta, MaxBundle, double);
+    alloc_vector(qp->tmp, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_vector(qp->grad, MaxBundle, double);
+    alloc_vector(qp->p, MaxBundle + 1, double);
+    qp->lwork = 64 * (MaxBundle + 1);
+    alloc_vector(qp->work, qp->lwork, double);
+    alloc_vector(qp->ipiv, MaxBundle + 1, int);
+    alloc_vector(qp->idx, MaxBundle, int);
+    ctx->qp_ws = qp;
+
+    /* compiled cutting planes (families that are not used get no storage) */
+    CutOperator *op;
+    alloc(op, CutOperator);
+    int width[3] = {3, 10, 21};
+    int cap[3] = {MaxTriIneqAdded,
+                  params->include_Pent ? MaxPentIneqAdded : 0,
+                  params->include_Hepta ? MaxHeptaIneqAdded : 0};
+    double scale[3] = {1.0, 0.5, 1.0/3.0};
+    double half[3] = {0.5, 0.25, 1.0/6.0};
+    for (int f = 0; f < 3; ++f) {
+        CutFamily *F = &op->fam[f];
+        F->width = width[f];
+        F->cap = cap[f];
+        F->scale = scale[f];
+        F->half = half[f];
+        if (F->cap > 0) {
+            alloc_vector(F->idx, F->width * F->cap, int);
+            alloc_vector(F->idxT, F->width * F->cap, int);
+            alloc_vector(F->coef, F->width * F->cap, double);
+        }
+    }
+    alloc_vector(op->sum, MaxTriIneqAdded, double);
+    ctx->cut_op = op;
+
+    /* solution of ipm_mc_pk in the current node (matrix only needed for warm starts) */
+    alloc(ctx->ipm_cur, IPMPoint);
+    alloc_vector(ctx->ipm_cur->vars, N, int);
+    alloc_vector(ctx->ipm_cur->y, N, double);
+    if (params->ipm_warm_start) {
+        alloc_matrix(ctx->ipm_cur->X, N, double);
+    }
+
+    /* cuts kept for the children (vectors only needed for warm starts) */
+    alloc(ctx->cuts_cur, CutSet);
+    if (params->cut_warm_start) {
+        alloc_vector(ctx->cuts_cur->Cuts, MaxTriIneqAdded, Triangle_Inequality);
+        alloc_vector(ctx->cuts_cur->Pent_Cuts, MaxPentIneqAdded, Pentagonal_Inequality);
+        alloc_vector(ctx->cuts_cur->Hepta_Cuts, MaxHeptaIneqAdded, Heptagonal_Inequality);
+    }
+
+    /* hash sets of the current cuts (families that are not used get no storage) */
+    int max_cuts[3] = {MaxTriIneqAdded,
+                       params->include_Pent ? MaxPentIneqAdded : 0,
+                       params->include_Hepta ? MaxHeptaIneqAdded : 0};
+    for (int f = 0; f < 3; ++f) {
+        CutHash *set;
+        alloc(set, CutHash);
+        if (max_cuts[f] > 0) {
+            set->slots = 1;
+            while (set->slots < 2 * max_cuts[f])
+                set->slots *= 2;
+            alloc_vector(set->table, set->slots, int);
+            alloc_vector(set->hash, max_cuts[f], uint64_t);
+            alloc_vector(set->keys, (size_t) CUT_KEY_SIZE * max_cuts[f], int);
+        }
+        ctx->cut_hash[f] = set;
+    }
+
+    /* pool cuts evaluated by CutPool_Probe */
+    if (params->cut_pool > 0) {
+        alloc_vector(ctx->pool_cuts, params->cut_pool, PoolCut);
+    }
 
     /* triangle inequalities */
-    alloc_vector(Cuts, MaxTriIneqAdded, Triangle_Inequality);
-    alloc_vector(List, params.TriIneq, Triangle_Inequality);
+    alloc_vector(ctx->Cuts, MaxTriIneqAdded, Triangle_Inequality);
+    alloc_vector(ctx->List, params->TriIneq, Triangle_Inequality);
+    if (params->sep_threads > 1) {
+        alloc_vector(ctx->tri_heaps, (size_t) (params->sep_threads - 1) * params->TriIneq, Triangle_Inequality);
+    }
+    alloc_vector(ctx->tri_rowmax, N, double);
 
     /* pentagonal inequalities */
-    alloc_vector(Pent_Cuts, MaxPentIneqAdded, Pentagonal_Inequality);
-    alloc_vector(Pent_List, 3 * params.Pent_Trials, Pentagonal_Inequality);
+    alloc_vector(ctx->Pent_Cuts, MaxPentIneqAdded, Pentagonal_Inequality);
+    alloc_vector(ctx->Pent_List, 3 * params->Pent_Trials, Pentagonal_Inequality);
 
     /* heptagonal inequalities */
-    alloc_vector(Hepta_Cuts, MaxHeptaIneqAdded, Heptagonal_Inequality);
-    alloc_vector(Hepta_List, 4 * params.Hepta_Trials, Heptagonal_Inequality);
+    alloc_vector(ctx->Hepta_Cuts, MaxHeptaIneqAdded, Heptagonal_Inequality);
+    alloc_vector(ctx->Hepta_List, 4 * params->Hepta_Trials, Heptagonal_Inequality);
 
     /* primal and dual variables */
-    alloc_matrix(X, N, double);
-    alloc_matrix(Z, N, double);
-    alloc_vector(X_bundle, N * N * MaxBundle, double);
-    alloc_matrix(X_test, N, double);
-    alloc_vector(dual_gamma, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
-    alloc_vector(dgamma, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
-    alloc_vector(gamma_test, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
-    alloc_vector(lambda, MaxBundle, double);
-    alloc_vector(eta, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
-    alloc_vector(F, MaxBundle, double);
-    alloc_vector(G, (MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded) * MaxBundle, double);   
-    alloc_vector(g, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double); 
+    alloc_matrix(ctx->X, N, double);
+    alloc_matrix(ctx->Z, N, double);
+    alloc_vector(ctx->X_bundle, MaxBundle + 1, double *);
+    alloc_vector(ctx->X_packed, (size_t) N * (N + 1) / 2, double);
+    alloc_matrix(ctx->X_test, N, double);
+    alloc_vector(ctx->dual_gamma, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_vector(ctx->dgamma, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_vector(ctx->gamma_test, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_vector(ctx->lambda, MaxBundle, double);
+    alloc_vector(ctx->eta, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double);
+    alloc_vector(ctx->F, MaxBundle, double);
+    ctx->G = NULL;                      // allocated on demand (Bundle_ReserveG)
+    ctx->G_size = 0;
+    alloc_vector(ctx->g, MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded, double); 
 }
 
 
-void freeMemory(void) {
+/* 
+ * Estimated size (in bytes) of the bounding workspace of one worker: memory allocated 
+ * in allocMemory.
+ */
+size_t workspaceMemory(const BiqBinContext *ctx) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
+    size_t nn = (size_t) ctx->tree->SP->n * ctx->tree->SP->n;
+    size_t ineq = MaxTriIneqAdded + MaxPentIneqAdded + MaxHeptaIneqAdded;
+    size_t bytes = 0;
+
+    /* PP->L, X, Z, X_test */
+    bytes += 4 * nn * sizeof(double);
+
+    /* bundle matrices in packed form: slots are allocated on demand, at most one per
+     * bundle iteration and outer iteration of a node (bundle is purged in between) */
+    size_t slots = (size_t) params->max_outer_iter * (params->max_bundle_iter + 1) + 2;
+    if (slots > MaxBundle + 1)
+        slots = MaxBundle + 1;
+    bytes += (slots + 1) * ((nn + ctx->tree->SP->n) / 2) * sizeof(double);
+
+    /* workspace of ipm_mc_pk and fct_eval: 8 matrices and vectors (dsyevr needs 26n doubles and 10n ints) */
+    bytes += 8 * nn * sizeof(double);
+    bytes += (3 + 26) * (size_t) ctx->tree->SP->n * sizeof(double) + 10 * (size_t) ctx->tree->SP->n * sizeof(int);
+
+    /* single precision workspace: 8 matrices and 3 vectors */
+    if (params->ipm_mixed_precision)
+        bytes += (8 * nn + 3 * (size_t) ctx->tree->SP->n) * sizeof(float);
+
+    /* workspace of lambda_eta and solve_lambda: G'G, KKT matrix, vectors and dsytrf work array */
+    bytes += ((size_t) MaxBundle * MaxBundle + (size_t) (MaxBundle + 1) * (MaxBundle + 1)) * sizeof(double);
+    bytes += (3 * MaxBundle + 2 * ineq + 65 * (MaxBundle + 1)) * sizeof(double) + (3 * MaxBundle + 1 + 2 * ineq) * sizeof(int);
+
+    /* compiled cutting planes: index, transposed index and coefficient of every entry */
+    size_t entries = 3 * (size_t) MaxTriIneqAdded;
+    if (params->include_Pent)
+        entries += 10 * (size_t) MaxPentIneqAdded;
+    if (params->include_Hepta)
+        entries += 21 * (size_t) MaxHeptaIneqAdded;
+    bytes += entries * (2 * sizeof(int) + sizeof(double)) + MaxTriIneqAdded * sizeof(double);
+
+    /* solution of ipm_mc_pk in the current node (final points of open nodes are counted as node memory) */
+    if (params->ipm_warm_start)
+        bytes += nn * sizeof(double);
+
+    /* final cuts of the current node (cuts of open nodes are counted as node memory) */
+    if (params->cut_warm_start)
+        bytes += MaxTriIneqAdded * sizeof(Triangle_Inequality) + MaxPentIneqAdded * sizeof(Pentagonal_Inequality) +
+                 MaxHeptaIneqAdded * sizeof(Heptagonal_Inequality);
+
+    /* hash sets of the current cuts: table (at most 4 ints per cut), hash and key of every cut */
+    size_t cuts = MaxTriIneqAdded;
+    if (params->include_Pent)
+        cuts += MaxPentIneqAdded;
+    if (params->include_Hepta)
+        cuts += MaxHeptaIneqAdded;
+    bytes += cuts * ((4 + CUT_KEY_SIZE) * sizeof(int) + sizeof(uint64_t));
 
-    free(SP->L);
-    free(SP);
-    free(PP->L);
-    free(PP);
+    /* pool cuts evaluated by CutPool_Probe */
+    if (params->cut_pool > 0)
+        bytes += params->cut_pool * sizeof(PoolCut);
+
+    /* triangle, pentagonal and heptagonal inequalities */
+    bytes += (MaxTriIneqAdded + params->TriIneq) * sizeof(Triangle_Inequality);
+    if (params->sep_threads > 1)
+        bytes += (size_t) (params->sep_threads - 1) * params->TriIneq * sizeof(Triangle_Inequality);
+    bytes += ctx->tree->SP->n * sizeof(double);
+    bytes += (MaxPentIneqAdded + 3 * params->Pent_Trials) * sizeof(Pentagonal_Inequality);
+    bytes += (MaxHeptaIneqAdded + 4 * params->Hepta_Trials) * sizeof(Heptagonal_Inequality);
+
+    /* dual variables: dual_gamma, dgamma, gamma_test, eta, g, lambda and F */
+    bytes += (5 * ineq + 2 * MaxBundle) * sizeof(double);
+
+    /* subgradients G: allocated on demand, one column of the current cuts per bundle slot */
+    bytes += cuts * slots * sizeof(double);
+
+    return bytes;
+}
+
+
+/* free bounding workspace of the worker */
+void freeWorkspace(BiqBinContext *ctx) {
+
+    free(ctx->PP->L);
+    free(ctx->PP);
+    free(ctx->PP_vars);
+
+    IPMWorkspace *ws = ctx->ipm_ws;
+    free(ws->Z);
+    free(ws->dX);
+    free(ws->dX1);
+    free(ws->Zi);
+    free(ws->M);
+    free(ws->tmp);
+    free(ws->tmp2);
+    free(ws->dy);
+    free(ws->dy1);
+    free(ws->b);
+    free(ws->L0);
+    free(ws->work);
+    free(ws->iwork);
+    free(ws->sL);
+    free(ws->sX);
+    free(ws->sZ);
+    free(ws->sZi);
+    free(ws->sM);
+    free(ws->sdX);
+    free(ws->sdX1);
+    free(ws->stmp);
+    free(ws->sy);
+    free(ws->sdy);
+    free(ws->sdy1);
+    free(ws);
+
+    QPWorkspace *qp = ctx->qp_ws;
+    free(qp->GtG);
+    free(qp->cols);
+    free(qp->rows);
+    free(qp->prev);
+    free(qp->col);
+    free(qp->K);
+    free(qp->c);
+    free(qp->zeta);
+    free(qp->tmp);
+    free(qp->grad);
+    free(qp->p);
+    free(qp->work);
+    free(qp->ipiv);
+    free(qp->idx);
+    free(qp);
+
+    for (int f = 0; f < 3; ++f) {
+        free(ctx->cut_op->fam[f].idx);
+        free(ctx->cut_op->fam[f].idxT);
+        free(ctx->cut_op->fam[f].coef);
+    }
+    free(ctx->cut_op->sum);
+    free(ctx->cut_op);
+
+    free(ctx->ipm_cur->vars);
+    free(ctx->ipm_cur->y);
+    free(ctx->ipm_cur->X);
+    free(ctx->ipm_cur);
+
+    free(ctx->cuts_cur->Cuts);
+    free(ctx->cuts_cur->Pent_Cuts);
+    free(ctx->cuts_cur->Hepta_Cuts);
+    free(ctx->cuts_cur);
+
+    for (int f = 0; f < 3; ++f) {
+        free(ctx->cut_hash[f]->table);
+        free(ctx->cut_hash[f]->hash);
+        free(ctx->cut_hash[f]->keys);
+        free(ctx->cut_hash[f]);
+    }
+    free(ctx->pool_cuts);
+
+    free(ctx->Cuts);
+    free(ctx->List);
+    free(ctx->tri_heaps);
+    free(ctx->tri_rowmax);
+
+    free(ctx->Pent_Cuts);
+    free(ctx->Pent_List);
+
+    free(ctx->Hepta_Cuts);
+    free(ctx->Hepta_List);
+
+    free(ctx->X);
+    free(ctx->Z);
+    for (int i = 0; i <= MaxBundle; ++i)
+        free(ctx->X_bundle[i]);
+    free(ctx->X_bundle);
+    free(ctx->X_packed);
+    free(ctx->X_test);
+    free(ctx->dual_gamma);
+    free(ctx->dgamma);
+    free(ctx->gamma_test);
+    free(ctx->lambda);
+    free(ctx->eta);
+    free(ctx->F);
+    free(ctx->G);
+    free(ctx->g);
+}
 
-    free(Cuts);
-    free(List);
 
-    free(Pent_Cuts);
-    free(Pent_List);
+void freeMemory(BiqBinContext *ctx) {
 
-    free(Hepta_Cuts);
-    free(Hepta_List);
+    free(ctx->tree->SP->L);
+    free(ctx->tree->SP);
 
-    free(X);
-    free(Z);
-    free(X_bundle);
-    free(X_test);
-    free(dual_gamma);
-    free(dgamma);
-    free(gamma_test);
-    free(lambda);
-    free(eta);
-    free(F);
-    free(G);
-    free(g);
+    freeWorkspace(ctx);
 
-    free(BabSol);
+    free(ctx->tree->BabSol);
 }
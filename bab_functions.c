@@ -6,57 +6,45 @@
 
 #include "biqbin.h"
   
-/* defined in heap.c */  
-extern int BabPbSize;           
-extern BabSolution *BabSol;
-
-extern FILE *output;    
-extern BiqBinParameters params;
-extern Problem *SP;
-extern Problem *PP;
-extern double root_bound;
-extern double TIME;
-extern int stopped;
-
-
 /* initialize global lower bound to 0 and global solution vector to zero */
-void initializeBabSolution(void) {
+void initializeBabSolution(BiqBinContext *ctx) {
 
-    BabSolution bs;
+    int x[ctx->tree->BabPbSize];
 
-    for (int i = 0; i < BabPbSize; ++i) {
-        bs.X[i] = 0;
+    for (int i = 0; i < ctx->tree->BabPbSize; ++i) {
+        x[i] = 0;
     }
 
-    Bab_LBInit(0, &bs);
+    Bab_LBInit(ctx, 0, x);
 }
 
 
 /************** Initialization: root node and priority queue **************/
-void Init_PQ(void) {
+void Init_PQ(BiqBinContext *ctx) {
     
-    extern BabNode *BabRoot;
+    BabTree *tree = ctx->tree;
 
     // Create the root node
-    BabRoot = newNode(NULL);
+    tree->BabRoot = newNode(ctx, NULL);
 
     // increase number of evaluated nodes
-    Bab_incEvalNodes();
+    Bab_incEvalNodes(ctx);
     
     // Evaluate root node: compute upper and lower bound 
-    root_bound = Evaluate(BabRoot, SP, PP);
+    tree->root_bound = Evaluate(ctx, tree->BabRoot);
 
     // save upper bound
-    BabRoot->upper_bound = root_bound; 
+    tree->BabRoot->upper_bound = tree->root_bound; 
 
     /* insert node into the priority queue or prune */
     // NOTE: optimal solution has INTEGER value, i.e. add +1 to lower bound
-    if (Bab_LBGet() + 1.0 < BabRoot->upper_bound) {      
-        Bab_PQInsert(BabRoot); 
+    if (Bab_LBGet(ctx) + 1.0 < tree->BabRoot->upper_bound) {      
+        keepWarmStart(ctx, tree->BabRoot);
+        Bab_PQInsert(ctx, tree->BabRoot); 
     }
     else {
         // otherwise, upper_bound <= BabLB, so we can prune
-        free(BabRoot);
+        freeNode(ctx, tree->BabRoot);
     }
 }
 
@@ -65,28 +53,48 @@ void Init_PQ(void) {
  * Bab function which initializes the problem, allocate the structures 
  * and evaluate the root node.
  */
-void Bab_Init() {
+void Bab_Init(BiqBinContext *ctx) {
 
     // Start the timer
-    TIME = time_wall_clock();
+    ctx->tree->TIME = time_wall_clock();
 
-    // Process the command line arguments
+    // the root node is evaluated first (see SDPbound)
+    ctx->tree->root_node = 1;
+    ctx->tree->diff = 0.0;
 
     // Provide B&B with an initial solution
-    initializeBabSolution();
+    initializeBabSolution(ctx);
 
     // Allocate the memory
-    allocMemory();
+    allocMemory(ctx);
 
     // Initialize root node
-    Init_PQ(); 
+    Init_PQ(ctx); 
+}
+
+/* 
+ * Bab function which restores the state of an interrupted solve from a checkpoint
+ * (see checkpoint.c) instead of evaluating the root node.
+ */
+void Bab_Resume(BiqBinContext *ctx, const char *path) {
+
+    // the root node has already been evaluated
+    ctx->tree->root_node = 0;
+
+    // Allocate the memory
+    allocMemory(ctx);
+
+    // Restore lower bound, solution, counters and open nodes
+    Checkpoint_Read(ctx, path);
 }
 
 /* NOTE: int *sol in functions evaluateSolution and updateSolution have length BabPbSize
  * -> to get objecive multiple with Laplacian that is stored in upper left corner of SP->L
  */
-double evaluateSolution(int *sol) {
+double evaluateSolution(const BiqBinContext *ctx, int *sol) {
 
+    const Problem *SP = ctx->tree->SP;
+    int BabPbSize = ctx->tree->BabPbSize;
     double val = 0.0;
     
     for (int i = 0; i < BabPbSize; ++i) {
@@ -102,111 +110,238 @@ double evaluateSolution(int *sol) {
  * Only this function can update best solution and value.
  * Returns 1 if success.
  */
-int updateSolution(int *x) {
+int updateSolution(BiqBinContext *ctx, int *x) {
     
     int solutionAdded = 0;
     double sol_value;
-    BabSolution solx;
-
-    // Copy x into solx --> because Bab_LBUpd needs BabSolution and not int*
-    for (int i = 0; i < BabPbSize; ++i) {
-      solx.X[i] = x[i];
-    }
 
-    sol_value = evaluateSolution(x); // computes objective value of solx
+    sol_value = evaluateSolution(ctx, x); // computes objective value of x
 
     /* If new solution is better than the global solution, 
      * then update and print the new solution. */
     
-    if (Bab_LBUpd(sol_value, &solx)) {
+    if (Bab_LBUpd(ctx, sol_value, x)) {
         solutionAdded = 1;
-        printf("Node %d Feasible solution %.0lf\n", Bab_numEvalNodes(), Bab_LBGet() );
-        fprintf(output,"Node %d Feasible solution %.0lf\n", Bab_numEvalNodes(), Bab_LBGet() );
+        printf("Node %d Feasible solution %.0lf\n", Bab_numEvalNodes(ctx), Bab_LBGet(ctx) );
+        fprintf(ctx->tree->output,"Node %d Feasible solution %.0lf\n", Bab_numEvalNodes(ctx), Bab_LBGet(ctx) );
     }
     
     return solutionAdded;
 }
 
 
+/* 
+ * Node selection for diving: the child with the higher upper bound is processed next
+ * by the same worker, the other child is inserted into the priority queue.
+ * In HYBRID_DIVING mode the dive stops if the child is not close to the best bound 
+ * in the queue. Returns the node to process next or NULL if the dive stops.
+ */
+static BabNode* selectDiveChild(BiqBinContext *ctx, BabNode *children[2], int pure) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
+    BabNode *dive, *other;
+
+    if (children[0] == NULL || (children[1] != NULL && children[1]->upper_bound > children[0]->upper_bound)) {
+        dive = children[1];
+        other = children[0];
+    }
+    else {
+        dive = children[0];
+        other = children[1];
+    }
+
+    if (other != NULL)
+        Bab_PQInsert(ctx, other);
+
+    if (dive == NULL || pure)
+        return dive;
+
+    double best = Bab_PQBestBound(ctx);
+    double lb = Bab_LBGet(ctx);
+
+    if (best > lb && dive->upper_bound < best - params->dive_gap * (best - lb)) {
+        Bab_PQInsert(ctx, dive);
+        return NULL;
+    }
+
+    return dive;
+}
+
+
 /* 
  * The function generates two new children of the current node of the 
  * branch-and-bound tree.
  * It also evaluates new generated nodes, i.e. computes upper and lower bound.
+ * Returns the child to process next when diving, otherwise NULL.
  */
-void Bab_GenChild(BabNode *node) {
+BabNode* Bab_GenChild(BiqBinContext *ctx, BabNode *node) {
 
+    BabTree *tree = ctx->tree;
+    const BiqBinParameters *params = &tree->params;
+    FILE *output = tree->output;
     BabNode *child_node;
+    BabNode *children[2] = { NULL, NULL };  // children to branch on when diving
+
+    // Stop if the open nodes use more memory than allowed
+    if (params->memory_limit > 0 && Bab_nodeMemory(ctx) > (size_t) params->memory_limit * 1024 * 1024) {
+        int running = 0;
+        atomic_compare_exchange_strong(&tree->stopped, &running, STOPPED_MEMORY_LIMIT);
+    }
 
     // If the algorithm stops before finding the optimal solution, search in the 
     // nodes queue for the worst upper bound. 
-    if (stopped || params.root || (params.time_limit > 0 && (time_wall_clock() - TIME) > params.time_limit) ) {
+    if (tree->stopped || params->root || (params->time_limit > 0 && (time_wall_clock() - tree->TIME) > params->time_limit) ) {
         
         // signal to printFinalOutput that algorithm stopped early
-        stopped = 1;        
+        int running = 0;
+        atomic_compare_exchange_strong(&tree->stopped, &running, STOPPED_TIME_LIMIT);
 
-        free(node);
-        return;
+        freeNode(ctx, node);
+        return NULL;
+    }
+
+    // The global lower bound may have improved since the node was inserted into the queue
+    if (Bab_LBGet(ctx) + 1.0 >= node->upper_bound) {
+        freeNode(ctx, node);
+        return NULL;
     }
 
     // If it's a leaf of the B&B tree, add the solution and don't branch
-    if (isLeafNode(node)) {
-        updateSolution(node->sol.X);
-        free(node);
-        return;
+    if (isLeafNode(ctx, node)) {
+        int x[tree->BabPbSize];
+        getNodeSolution(ctx, node, x);
+        updateSolution(ctx, x);
+        freeNode(ctx, node);
+        return NULL;
     }
 
-    // Determine the variable x[ic] to branch on
-    int ic = getBranchingVariable(node);
+    // dive into a child (switch to pure diving if the open nodes use too much memory)
+    int pure = (params->nodeSelection == PURE_DIVING) || 
+               (params->dive_memory > 0 && Bab_nodeMemory(ctx) > (size_t) params->dive_memory * 1024 * 1024);
+    int dive = pure || (params->nodeSelection == HYBRID_DIVING);
+
+    // The variable x[ic] to branch on was determined when the node was evaluated
+    int ic = node->branch_var;
 
-    if (params.detailedOutput) {
-        fprintf(output, "Branching on x[%d] = %.2f\n", ic, node->fracsol[ic]);
+    if (params->detailedOutput) {
+        fprintf(output, "Branching on x[%d] = %.2f\n", ic, node->branch_frac);
     }    
 
+    // both children start the interior-point method from the final point kept with this node
+    // and the bundle method from its final cuts
+    ctx->parent = node->warm;
+
     // add two nodes to the search tree
     for (int xic = 0; xic <= 1; ++xic) { 
 
         // Create a new child node from the parent node
-        child_node = newNode(node);
+        child_node = newNode(ctx, node);
 
         // split on node ic
-        child_node->xfixed[ic] = 1;
-        child_node->sol.X[ic] = xic;
+        Bab_fixVariable(child_node, ic, xic);
 
-        if (params.detailedOutput) {
+        if (params->detailedOutput) {
             fprintf(output, "Fixing x[%d] = %d\n", ic, xic);
         }
             
         //increment the number of explored nodes
-        Bab_incEvalNodes();
+        Bab_incEvalNodes(ctx);
 
         // If it's a leaf of the B&B tree, add the solution and don't branch
-        if (isLeafNode(child_node)) {
-            updateSolution(child_node->sol.X);
-            free(child_node);
+        if (isLeafNode(ctx, child_node)) {
+            int x[tree->BabPbSize];
+            getNodeSolution(ctx, child_node, x);
+            updateSolution(ctx, x);
+            freeNode(ctx, child_node);
         }
         else {
 
             /* compute upper bound (SDP bound) and lower bound (via heuristic) for this node */
-            child_node->upper_bound = Evaluate(child_node, SP, PP);
+            child_node->upper_bound = Evaluate(ctx, child_node);
 
             /* if BabLB + 1.0 < child_node->upper_bound, 
              * then we must branch since there could be a better feasible 
              * solution in this subproblem
              */
-            if (Bab_LBGet() + 1.0 < child_node->upper_bound) {
-                /* insert node into the priority queue */
-                Bab_PQInsert(child_node); 
+            if (Bab_LBGet(ctx) + 1.0 < child_node->upper_bound) {
+                keepWarmStart(ctx, child_node);
+
+                /* insert node into the priority queue or keep it for diving */
+                if (dive)
+                    children[xic] = child_node;
+                else
+                    Bab_PQInsert(ctx, child_node); 
             }
             else {
                 // otherwise, upper_bound <= BabLB, so we can prune
-                free(child_node);
+                freeNode(ctx, child_node);
             }
         }
 
     } // end for xic
 
-    // free parent node
-    free(node);
+    // free parent node (and its starting point)
+    ctx->parent = NULL;
+    freeNode(ctx, node);
+
+    return dive ? selectDiveChild(ctx, children, pure) : NULL;
+}
+
+
+/* 
+ * Main loop of a B&B worker: takes nodes from its own heap (or steals them 
+ * from other workers) and branches until the whole B&B tree is processed.
+ * Worker 0 is the calling thread and uses the workspace allocated in Bab_Init,
+ * the other workers allocate their own bounding workspace.
+ */
+static void *Bab_Worker(void *arg) {
+
+    BiqBinContext *ctx = (BiqBinContext *) arg;
+    BabNode *node;
+
+    if (ctx->worker > 0)
+        allocMemory(ctx);
+
+    while ((node = Bab_PQPop(ctx)) != NULL) {
+        // a dive continues with a child of the processed node
+        while (node != NULL) {
+            node = Bab_GenChild(ctx, node);
+            if (node != NULL)
+                Checkpoint_SetCurrent(ctx, node);
+        }
+        Bab_PQNodeDone(ctx);
+
+        Checkpoint_Check(ctx);
+    }
+
+    if (ctx->worker > 0)
+        freeWorkspace(ctx);
+
+    return NULL;
+}
+
+
+/* Process the B&B tree with num_threads workers; ctx is the context of worker 0 */
+void Bab_Run(BiqBinContext *ctx, int num_threads) {
+
+    if (num_threads < 1)
+        num_threads = 1;
+
+    pthread_t threads[num_threads];
+    BiqBinContext workers[num_threads];
+
+    for (int w = 1; w < num_threads; ++w) {
+        workers[w] = (BiqBinContext) { .tree = ctx->tree, .worker = w };
+        if (pthread_create(&threads[w], NULL, Bab_Worker, &workers[w]) != 0) {
+            fprintf(stderr, "Error: Cannot create worker thread %d.\n", w);
+            exit(1);
+        }
+    }
+
+    Bab_Worker(ctx);
+
+    for (int w = 1; w < num_threads; ++w)
+        pthread_join(threads[w], NULL);
 }
 
 
@@ -221,11 +356,11 @@ double time_wall_clock(void)  {
 
 
 /* print solution 0-1 vector */
-void printSolution(FILE *file) {
+void printSolution(const BiqBinContext *ctx, FILE *file) {
 
     fprintf(file, "Solution = ( ");
-    for (int i = 0; i < BabPbSize; ++i) {
-        if (BabSol->X[i] == 1) {
+    for (int i = 0; i < ctx->tree->BabPbSize; ++i) {
+        if (ctx->tree->BabSol->X[i] == 1) {
             fprintf(file, "%d ", i + 1);
         }
     }
@@ -234,21 +369,29 @@ void printSolution(FILE *file) {
 
 
 /* print final output */
-void printFinalOutput(FILE *file, int num_nodes) {
+void printFinalOutput(const BiqBinContext *ctx, FILE *file, int num_nodes) {
+
+    const BabTree *tree = ctx->tree;
+    double root_bound = tree->root_bound;
 
     // Best solution found
-    double best_sol = Bab_LBGet();
+    double best_sol = Bab_LBGet(ctx);
 
     fprintf(file, "\nNodes = %d\n", num_nodes);
     
     // normal termination
-    if (!stopped) {
+    if (!tree->stopped) {
         fprintf(file, "Root node bound = %.3lf\n", root_bound);
         fprintf(file, "Maximum value = %.0lf\n", best_sol);
-        printSolution(file);
+        printSolution(ctx, file);
         
     } else { // B&B stopped early
-        if (params.root) {
+        if (tree->params.root) {
+            fprintf(file, "Root node bound = %.3lf\n", root_bound);
+            fprintf(file, "Best value = %.0lf\n", best_sol);
+        }
+        else if (tree->stopped == STOPPED_MEMORY_LIMIT) {
+            fprintf(file, "MEMORY LIMIT REACHED.\n");
             fprintf(file, "Root node bound = %.3lf\n", root_bound);
             fprintf(file, "Best value = %.0lf\n", best_sol);
         }
@@ -257,10 +400,36 @@ void printFinalOutput(FILE *file, int num_nodes) {
             fprintf(file, "Root node bound = %.3lf\n", root_bound);
             fprintf(file, "Best value = %.0lf\n", best_sol);
         }    
-        printSolution(file);
+        printSolution(ctx, file);
     }
 
-    fprintf(file, "Wall clock time = %.2f s\n\n", time_wall_clock() - TIME);
+    // node pool statistics (output file only)
+    if (file != stdout && tree->pools != NULL) {
+        int slabs = 0;
+        size_t bytes = 0;
+        for (int w = 0; w < tree->numWorkers; ++w) {
+            slabs += tree->pools[w].numSlabs;
+            bytes += tree->pools[w].slabBytes;
+        }
+        fprintf(file, "Peak live nodes = %d, node pool slabs = %d (%.1f MB)\n", 
+                atomic_load(&tree->peakNodes), slabs, bytes / (1024.0 * 1024.0));
+    }
+
+    // spill statistics (output file only)
+    if (file != stdout && tree->spill != NULL) {
+        fprintf(file, "Spilled nodes = %zu, peak spilled nodes = %zu, peak spill file size = %.1f MB\n", 
+                tree->spill->totalSpilled, tree->spill->peakNodes, tree->spill->peakBytes / (1024.0 * 1024.0));
+    }
+
+    // cut pool statistics (output file only)
+    if (file != stdout && tree->cut_pool != NULL) {
+        CutPool *pool = tree->cut_pool;
+        fprintf(file, "Cut pool = %d cuts, %zu probed, %zu added (hit rate %.1f%%), %zu stored, %zu evicted\n",
+                pool->size, pool->probed, pool->hits, (pool->probed > 0) ? 100.0 * pool->hits / pool->probed : 0.0,
+                pool->stored, pool->evicted);
+    }
+
+    fprintf(file, "Wall clock time = %.2f s\n\n", time_wall_clock() - tree->TIME);
 }
 
 
@@ -269,49 +438,53 @@ void printFinalOutput(FILE *file, int num_nodes) {
  * nodes evaluated, the best solution found, the nodes best bound, the wall clock time.
  * It is also used to free the memory allocated by the program.
  */
-void Bab_End(void) {
+void Bab_End(BiqBinContext *ctx) {
 
     /* Print results to the standard output and to the output file */
-    printFinalOutput(stdout,Bab_numEvalNodes());
-    printFinalOutput(output,Bab_numEvalNodes());
+    printFinalOutput(ctx, stdout,Bab_numEvalNodes(ctx));
+    printFinalOutput(ctx, ctx->tree->output,Bab_numEvalNodes(ctx));
 
-    freeMemory();
+    freeMemory(ctx);
 
-    fclose(output);
+    fclose(ctx->tree->output);
+    ctx->tree->output = NULL;
 }
 
 
 /*
- * getBranchingVariable function used in the Bab_GenChild routine to determine
- * which variable x[ic] to branch on.
+ * getBranchingVariable function used in the bounding routine (SDPbound) to determine
+ * which variable x[ic] to branch on. The result is stored in the node and used in Bab_GenChild.
  *
  * node: the current node of the branch-and-bound search tree
+ * fracsol: fractional vector obtained from primal matrix X (last column except last element)
  */
-int getBranchingVariable(BabNode *node) {
+int getBranchingVariable(const BiqBinContext *ctx, BabNode *node, const double *fracsol) {
 
+    const BiqBinParameters *params = &ctx->tree->params;
+    int BabPbSize = ctx->tree->BabPbSize;
     int ic = -1;  // x[ic] is the variable to branch on
     double maxValue, minValue;
 
     /* 
      * Choose the branching variable x[ic] based on params.branchingStrategy
      */
-    if (params.branchingStrategy == LEAST_FRACTIONAL) {
+    if (params->branchingStrategy == LEAST_FRACTIONAL) {
         // Branch on the variable x[ic] that has the least fractional value
         maxValue = -BIG_NUMBER;
         for (int i = 0; i < BabPbSize; ++i) {
-            if (!(node->xfixed[i]) && fabs(0.5 - node->fracsol[i]) > maxValue) {
+            if (!Bab_isFixed(node, i) && fabs(0.5 - fracsol[i]) > maxValue) {
                 ic = i;
-                maxValue = fabs(0.5 - node->fracsol[ic]);
+                maxValue = fabs(0.5 - fracsol[ic]);
             }
         }
     }
-    else if (params.branchingStrategy == MOST_FRACTIONAL) {
+    else if (params->branchingStrategy == MOST_FRACTIONAL) {
         // Branch on the variable x[ic] that has the most fractional value
         minValue = BIG_NUMBER;
         for (int i = 0; i < BabPbSize; ++i) {
-            if (!(node->xfixed[i]) && fabs(0.5 - node->fracsol[i]) < minValue) {
+            if (!Bab_isFixed(node, i) && fabs(0.5 - fracsol[i]) < minValue) {
                 ic = i;
-                minValue = fabs(0.5 - node->fracsol[ic]);
+                minValue = fabs(0.5 - fracsol[ic]);
             }
         }
     }
@@ -324,21 +497,19 @@ int getBranchingVariable(BabNode *node) {
 }
 
 
-/* Count the number of fixed variables */
-int countFixedVariables(BabNode *node) {
+/* Count the number of fixed variables (popcount of the xfixed bitset) */
+int countFixedVariables(const BabNode *node) {
     
     int numFixedVariables = 0;
 
-    for (int i = 0; i < BabPbSize; ++i) {
-        if (node->xfixed[i]) {
-            ++numFixedVariables;
-        }
+    for (int w = 0; w < node->words; ++w) {
+        numFixedVariables += __builtin_popcountll(node->bits[w]);
     }
 
     return numFixedVariables;
 }
 
 /* Determine if node is a leaf node by counting the number of fixed variables */
-int isLeafNode(BabNode *node) {
-    return (countFixedVariables(node) == BabPbSize);
+int isLeafNode(const BiqBinContext *ctx, BabNode *node) {
+    return (countFixedVariables(node) == ctx->tree->BabPbSize);
 }
@@ -1,44 +1,70 @@
 #include "biqbin.h"  
 
+/* Solve the Max-Cut problem; if resume is set, continue from the checkpoint of the instance */
+static int solve(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters, int resume) {
 
-#define HEAP_SIZE 10000000
+    // every solve owns its B&B tree; ctx is the context of worker 0 (main thread)
+    BabTree tree = { 0 };
+    BiqBinContext ctx = { .tree = &tree, .worker = 0 };
 
-extern Heap *heap;
-extern FILE *output;
+    seedRandom(&ctx, 2024);
 
-/// @brief Solve the Max-Cut problem using the branch-and-bound algorithm. Make sure output file is open.
-/// @param MC_input_data 
-/// @param biqbin_parameters 
-/// @return 
-
-int compute(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters) {
-
-    srand(2024);
-    /*** allocate priority queue***/
-    heap = Init_Heap(HEAP_SIZE);
-
-    openOutputFile(MC_input_data->name);
-    setParams(biqbin_parameters);
+    openOutputFile(&ctx, MC_input_data->name);
+    setParams(&ctx, biqbin_parameters);
     
     // Output information about the instance
-    processAdjMatrixSetPP_SP(MC_input_data);
+    processAdjMatrixSetPP_SP(&ctx, MC_input_data);
     
-    printHeader(MC_input_data);
+    printHeader(&ctx, MC_input_data);
+    writeParameters(tree.output, biqbin_parameters);
+    fprintf(tree.output, "\n");
     // the rest is the same as in the original main.c
-    BabNode *node;
+    int num_threads = (biqbin_parameters.num_threads > 0) ? biqbin_parameters.num_threads : 1;
+
+    printMemoryEstimate(&ctx, num_threads);
 
-    /*** allocate priority queue ***/
-    heap = Init_Heap(HEAP_SIZE);
+    /*** allocate priority queue: one heap per worker ***/
+    Init_PQ_Workers(&ctx, num_threads);
+    Checkpoint_Init(&ctx, MC_input_data->name);
+    CutPool_Init(&ctx);
 
-    Bab_Init();
-    while (!isPQEmpty()) {
-        node = Bab_PQPop();
-        Bab_GenChild(node);
+    if (resume) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s.checkpoint", MC_input_data->name);
+        Bab_Resume(&ctx, path);
     }
+    else
+        Bab_Init(&ctx);
+
+    Bab_Run(&ctx, num_threads);
 
     /* prints solution and frees memory */
-    Bab_End();
-    free(heap->data);
-    free(heap);
+    Bab_End(&ctx);
+
+    // checkpoint is not needed if the solve finished
+    Checkpoint_Free(&ctx, !tree.stopped);
+    CutPool_Free(&ctx);
+    Free_PQ_Workers(&ctx);
+    freeRandom(&ctx);
     return 0;
+}
+
+
+/// @brief Solve the Max-Cut problem using the branch-and-bound algorithm. Make sure output file is open.
+/// @param MC_input_data 
+/// @param biqbin_parameters 
+/// @return 
+
+int compute(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters) {
+    return solve(MC_input_data, biqbin_parameters, 0);
+}
+
+
+/// @brief Continue the solve from the checkpoint <name>.checkpoint written by an interrupted run.
+/// @param MC_input_data 
+/// @param biqbin_parameters 
+/// @return 
+
+int compute_resume(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters) {
+    return solve(MC_input_data, biqbin_parameters, 1);
 }
\ No newline at end of file
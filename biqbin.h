@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
 
 #define BIG_NUMBER 1e+9
 
@@ -14,10 +17,24 @@
 /* Maximum size of bundle */
 #define MaxBundle 400
 
+/* Reasons for stopping the B&B algorithm early (BabTree.stopped) */
+#define STOPPED_TIME_LIMIT    1         // also used when only the root node is evaluated
+#define STOPPED_MEMORY_LIMIT  2
+
 /* Branching strategies */
 #define LEAST_FRACTIONAL  0
 #define MOST_FRACTIONAL   1
 
+/* Node selection strategies */
+#define BEST_FIRST        0     // node with the highest upper bound
+#define HYBRID_DIVING     1     // dive into the better child while it is close to the best bound
+#define PURE_DIVING       2     // always dive into the better child
+
+/* Results of ipm_mc_pk */
+#define IPM_CONVERGED     0     // duality gap below tolerance
+#define IPM_PRUNE         1     // dual value proves that the node can be pruned
+#define IPM_NO_PRUNE      2     // primal value proves that the node cannot be pruned in this round
+
 /* macros for allocating vectors and matrices */
 #define alloc_vector(var, size, type)\
     var = (type *) calloc((size) , sizeof(type));\
@@ -29,7 +46,7 @@
     }
 
 #define alloc(var, type) alloc_vector(var, 1, type)
-#define alloc_matrix(var, size, type) alloc_vector(var, (size)*(size), type)
+#define alloc_matrix(var, size, type) alloc_vector(var, (size_t)(size)*(size), type)
 
 
 // BiqBin parameters and default values
@@ -47,9 +64,22 @@
     P(int,      include_Hepta,       "%d",                 1) \
     P(int,      root,                "%d",                 0) \
     P(int,      use_diff,            "%d",                 1) \
+    P(int,      ipm_warm_start,      "%d",                 0) \
+    P(int,      ipm_early_stop,      "%d",                 0) \
+    P(int,      ipm_mixed_precision, "%d",                 0) \
+    P(int,      cut_warm_start,      "%d",                 0) \
+    P(int,      cut_pool,            "%d",                 0) \
+    P(int,      sep_threads,         "%d",                 1) \
     P(int,      time_limit,          "%d",                 0) \
+    P(int,      memory_limit,        "%d",                 0) \
+    P(double,   spill_memory,        "%lf",                0) \
+    P(int,      checkpoint_interval, "%d",                 0) \
     P(int,      branchingStrategy,   "%d",   MOST_FRACTIONAL) \
-    P(int,      detailedOutput,      "%d",                 1) 
+    P(int,      nodeSelection,       "%d",        BEST_FIRST) \
+    P(double,   dive_gap,            "%lf",              0.1) \
+    P(int,      dive_memory,         "%d",                 0) \
+    P(int,      detailedOutput,      "%d",                 1) \
+    P(int,      num_threads,         "%d",                 1) 
 #endif
 
 
@@ -60,12 +90,27 @@ typedef struct BiqBinParameters {
 } BiqBinParameters;
 
 
+/*
+ * Hash set of the cuts of one family in the current node (see cutting_planes.c): cut
+ * keys (see cutKey) and their positions in the vector of cuts.
+ */
+#define CUT_KEY_SIZE 8
+
+typedef struct CutHash {
+    int slots;                          // size of the table (power of 2, at least twice the maximum number of cuts)
+    int *table;                         // position of the cut or -1 (linear probing)
+    uint64_t *hash;                     // hash of the key of each cut
+    int *keys;                          // key of each cut (CUT_KEY_SIZE ints per cut)
+} CutHash;
+
+
 /* Structure for storing triangle inequalities */
 typedef struct Triangle_Inequality {
     int i;
     int j;
     int k;
     int type;           // type: 1-4
+    int row;            // row of the cut in G before separation (-1 for new cuts)
     double value;       // cut violation 
     double y;           // corresponding dual multiplier
 } Triangle_Inequality;
@@ -75,6 +120,7 @@ typedef struct Triangle_Inequality {
 typedef struct Pentagonal_Inequality {
     int type;           // type: 1-3 (based on H1 = ee^T, ...)
     int permutation[5];
+    int row;            // row of the cut in G before separation (-1 for new cuts)
     double value;       // cut violation 
     double y;           // corresponding dual multiplier
 } Pentagonal_Inequality;
@@ -84,6 +130,7 @@ typedef struct Pentagonal_Inequality {
 typedef struct Heptagonal_Inequality {
     int type;           // type: 1-4 (based on H1 = ee^T, ...)
     int permutation[7];
+    int row;            // row of the cut in G before separation (-1 for new cuts)
     double value;       // cut violation 
     double y;           // corresponding dual multiplier
 } Heptagonal_Inequality;
@@ -106,42 +153,408 @@ typedef struct MaxCutInputData {
     double *Adj;         // Adjacency matrix to store edge weights
 } MaxCutInputData;
 
-/* Maximum number of variables */
-#define NMAX 512
-
 /* Solution of the problem */
 typedef struct BabSolution {
+    int n;              // number of variables (BabPbSize)
     /*
      * Vector X: Binary vector that stores the solution of the branch-and-bound algorithm
+     * (allocated at runtime with n elements)
      */
-    int X[NMAX];
+    int X[];
 } BabSolution;
 
 
 /*
  * Node of the branch-and-bound tree.
  * Structure that represent a node of the branch-and-bound tree and stores all the 
- * useful information.
+ * useful information. Its size is determined at runtime by BabPbSize: 
+ * the fixed variables and their values are stored as two bitsets of BAB_WORDS(BabPbSize)
+ * 64-bit words each, placed after the header in bits[]. 
  */
 typedef struct BabNode {
-    int xfixed[NMAX];       // 0-1 vector specifying which nodes are fixed
-    BabSolution sol;        // 0-1 solution vector
-    double fracsol[NMAX];   // fractional vector obtained from primal matrix X (last column except last element)
-                            // from bounding routine. Used for determining the next branching variable.
-    int level;              // level (depth) of the node in B&B tree     
     double upper_bound;     // upper bound on solution value of max-cut, i.e. MC <= upper_bound.
                             // Used for determining the next node in priority queue.  
+    struct NodeWarmStart *warm;  // starting point for the children (NULL if none or the node was spilled)
+    int level;              // level (depth) of the node in B&B tree     
+    int branch_var;         // variable x[branch_var] to branch on, determined from the fractional 
+                            // solution of the bounding routine (SDPbound)
+    float branch_frac;      // fractional value of x[branch_var] (only used for output)
+    int words;              // number of 64-bit words in each bitset
+    uint64_t bits[];        // xfixed = bits[0 .. words-1]: 0-1 vector specifying which nodes are fixed
+                            // sol    = bits[words .. 2*words-1]: 0-1 solution vector (0 if not fixed)
 } BabNode;
 
+/* number of 64-bit words needed for a bitset of n variables */
+#define BAB_WORDS(n) (((n) + 63) / 64)
+
+/* is variable x[i] fixed in node */
+static inline int Bab_isFixed(const BabNode *node, int i) {
+    return (node->bits[i >> 6] >> (i & 63)) & 1;
+}
+
+/* value of (fixed) variable x[i] in node */
+static inline int Bab_solValue(const BabNode *node, int i) {
+    return (node->bits[node->words + (i >> 6)] >> (i & 63)) & 1;
+}
+
+/* fix variable x[i] to value (0 or 1) */
+static inline void Bab_fixVariable(BabNode *node, int i, int value) {
+    uint64_t mask = (uint64_t) 1 << (i & 63);
+    node->bits[i >> 6] |= mask;
+    if (value)
+        node->bits[node->words + (i >> 6)] |= mask;
+    else
+        node->bits[node->words + (i >> 6)] &= ~mask;
+}
+
+
+/* 
+ * Pool allocator for B&B nodes: blocks of the same size class are carved from 
+ * slabs and released blocks are kept in a free list of the class (see heap.c).
+ * Block sizes of the classes are 16, 24, 32, 48, 64, 96, ... bytes.
+ */
+#define POOL_NUM_CLASSES 48
+#define POOL_SLAB_SIZE (1 << 20)        // minimal size of a slab in bytes
+
+typedef struct PoolSlab {
+    struct PoolSlab *next;              // next slab of the pool
+    size_t size;                        // size of data in bytes
+    char data[];
+} PoolSlab;
+
+typedef struct PoolClass {
+    void *free;                         // free list of released blocks
+    char *bump;                         // next unused block of the current slab
+    char *end;                          // end of the current slab
+} PoolClass;
+
+/* every worker owns one pool, so allocation and release need no locking */
+typedef struct NodePool {
+    PoolClass classes[POOL_NUM_CLASSES];
+    PoolSlab *slabs;                    // all slabs allocated by the pool
+    int numSlabs;
+    size_t slabBytes;                   // total size of the slabs in bytes
+} NodePool;
+
+
+/* 
+ * Priority queue of B&B nodes: bucket queue keyed on floor of upper bound.
+ * Bucket k holds nodes with upper_bound in [origin + k*width, origin + (k+1)*width),
+ * ordered in a binary max-heap. Since pruning is integral (BabLB + 1.0 < upper_bound), 
+ * all buckets below the lower bound are freed at once when the lower bound improves.
+ */
+#define PQ_MAX_BUCKETS 4096     // width of buckets is increased for larger ranges of upper bounds
+
+typedef struct Bucket {
+    int size;               /* allocated number of elements in bucket */
+    int used;               /* current number of elements in bucket */
+    BabNode** data;         /* heap of BabNodes */
+} Bucket;
 
 /* heap (data structure) declaration */
 typedef struct Heap {   
-    int size;               /* maximum number of elements in heap */
     int used;               /* current number of elements in heap */
-    BabNode** data;         /* array of BabNodes                  */  
+    double origin;          /* upper bound at the start of bucket 0 */
+    double width;           /* range of upper bounds in one bucket (power of 2) */
+    int numBuckets;         /* number of buckets (0 until first insert) */
+    int low;                /* buckets below low have been pruned */
+    int top;                /* highest non-empty bucket (-1 if heap is empty) */
+    Bucket *buckets;
+    pthread_mutex_t lock;   /* guards the heap against stealing workers */
 } Heap;
 
 
+/*
+ * Open B&B nodes spilled to a memory-mapped file (see spill.c).
+ * Nodes written at once form a segment of compact records.
+ */
+#define SPILL_BATCH 1024        // maximum number of nodes spilled or loaded at once
+
+typedef struct SpillSegment {
+    double bound;                       // highest upper bound of nodes in segment
+    size_t offset;                      // position of first record in file
+    int count;                          // number of records
+} SpillSegment;
+
+typedef struct SpillHole {
+    size_t offset;                      // position of unused space before the end of the file
+    size_t size;                        // size in bytes
+} SpillHole;
+
+typedef struct SpillStore {
+    int fd;                             // spill file (removed from directory)
+    char *map;                          // mapping of the file
+    size_t mapped;                      // size of file and mapping in bytes
+    size_t end;                         // end of used part of the file
+    int words;                          // BAB_WORDS(BabPbSize)
+    SpillSegment *segments;
+    int numSegments;
+    int maxSegments;
+    SpillHole *holes;                   // unused space left by loaded or pruned segments (sorted by offset)
+    int numHoles;
+    int maxHoles;
+    size_t numNodes;                    // number of spilled nodes
+    size_t peakNodes;                   // maximum number of spilled nodes
+    size_t totalSpilled;                // number of all spill operations on nodes
+    size_t peakBytes;                   // maximum used size of the file
+    _Atomic double top;                 // highest upper bound of spilled nodes
+    pthread_mutex_t lock;
+} SpillStore;
+
+
+/* Checkpoint of a running solve (see checkpoint.c) */
+#define RNG_STATE_SIZE 128      // size of the state of the random number generator
+
+typedef struct Checkpoint {
+    char path[256];                     // checkpoint file
+    double interval;                    // seconds between checkpoints
+    double last;                        // wall clock time of the last checkpoint
+    atomic_int writing;                 // set while a worker writes a checkpoint
+    int written;                        // number of written checkpoints
+    size_t recordSize;                  // size of a node record
+    char *current;                      // record of the node that each worker processes
+    int *busy;                          // 1 if the worker processes a node
+    atomic_int active;                  // set while the open nodes are streamed to the file
+    int fd;                             // file of the checkpoint that is written
+    int failed;                         // a write to fd failed
+    uint64_t numRecords;                // node records written to fd
+    pthread_mutex_t lock;               // guards current, busy, fd and numRecords
+} Checkpoint;
+
+
+/* Global pool of cutting planes shared by the workers (see cut_pool.c) */
+typedef struct PoolCut {
+    int family;                         // 0 triangle, 1 pentagonal, 2 heptagonal
+    int type;
+    int v[7];                           // vertices of the original graph (BabPbSize for the last row)
+    int key[CUT_KEY_SIZE];              // order-independent key of the cut (cutKey)
+    int active;                         // number of nodes in which the cut was active
+    int last;                           // number of evaluated nodes when the cut was last active
+    uint64_t hash;
+} PoolCut;
+
+typedef struct CutPool {
+    PoolCut *cuts;                      // cuts in insertion order (params.cut_pool)
+    int *table;                         // hash table: position of the cut in cuts or -1 (linear probing)
+    int cap;                            // maximum number of cuts
+    int size;                           // number of cuts
+    int slots;                          // size of the hash table (power of 2)
+    size_t probed;                      // pool cuts on free vertices evaluated at nodes
+    size_t hits;                        // pool cuts added to nodes (violated)
+    size_t stored;                      // active cuts stored at the end of nodes
+    size_t evicted;                     // cuts removed by aging
+    pthread_mutex_t lock;
+} CutPool;
+
+
+/*
+ * Work arrays of ipm_mc_pk and fct_eval, allocated once per worker for the size of the 
+ * original problem and used for all subproblems (the first n*n entries for size n).
+ */
+typedef struct IPMWorkspace {
+    double *Z, *dX, *dX1;               // dual matrix and step directions
+    double *Zi, *M, *tmp, *tmp2;        // inv(Z), Schur complement and temporary matrices
+    double *dy, *dy1, *b;               // step directions and vector of ones
+    double *L0;                         // objective matrix L - A^T(gamma) in fct_eval
+    double *work;                       // work arrays of dsyevr (centrality test of warm starts)
+    int *iwork;
+    int lwork, liwork;
+
+    /* single precision iterations (params.ipm_mixed_precision) */
+    int mixed;                          // first iterations in single precision
+    float *sL, *sX, *sZ, *sZi, *sM;     // n x n matrices
+    float *sdX, *sdX1, *stmp;
+    float *sy, *sdy, *sdy1;             // vectors
+} IPMWorkspace;
+
+
+/*
+ * Preallocated storage of lambda_eta and solve_lambda (bundle master problem).
+ * G'*G is kept up to date with G (see bundle.c), the QP matrix is t*G'*G.
+ */
+typedef struct QPWorkspace {
+    double *GtG;                        // G'*G (lower triangle, leading dimension MaxBundle)
+    int *cols;                          // kept bundle elements when the bundle is purged
+    int *rows;                          // marks of kept rows of G after separation
+    int *prev;                          // row in G before separation of each cut (-1 for new cuts)
+    double *col;                        // column of G while G is updated after separation
+    double *K;                          // LDL' factorization of the KKT matrix of the free indices
+    double *c, *tmp;                    // linear term of the QP and G*lambda
+    double *zeta;                       // -F - G'*gamma (bundle_method)
+    double *grad, *p;                   // gradient and step direction (with multiplier)
+    double *work;                       // work array of dsytrf
+    int *ipiv;                          // pivots of dsytrf
+    int *idx;                           // free indices (lambda_i > 0) in increasing order
+    int nfree;                          // number of free indices
+    int lwork;
+    int factored;                       // K belongs to the current Q and free set
+} QPWorkspace;
+
+
+/*
+ * Cutting planes compiled into a sparse operator (see operators.c). Entry e of cut c
+ * (pair of its vertices) is stored at e * cap + c.
+ */
+typedef struct CutFamily {
+    int width;                          // entries per cut: 3 (triangle), 10 (pentagonal), 21 (heptagonal)
+    int cap;                            // maximum number of cuts
+    int m;                              // number of compiled cuts
+    double scale;                       // factor of B(X) (1, 1/2, 1/3)
+    double half;                        // factor of Bt(t) (scale / 2 by symmetry)
+    int *idx, *idxT;                    // linear index into X of the entry and of its transpose
+    double *coef;                       // coefficient of the entry (+1 or -1)
+} CutFamily;
+
+typedef struct CutOperator {
+    CutFamily fam[3];                   // triangle, pentagonal and heptagonal inequalities
+    double *sum;                        // partial sums of op_B
+} CutOperator;
+
+
+/*
+ * Solution of ipm_mc_pk kept as a starting point for the next solve (params.ipm_warm_start).
+ * Rows are identified by the vertices of the original graph, so the point can be restricted 
+ * to a subproblem with fewer free variables.
+ */
+typedef struct IPMPoint {
+    int n;                              // size of the stored point (0 if there is none)
+    int *vars;                          // vertex of each row in increasing order (BabPbSize for the last row)
+    double *X;                          // primal matrix
+    double *y;                          // dual vector
+} IPMPoint;
+
+
+/*
+ * Cutting planes of a node with their dual multipliers, kept for its children
+ * (params.cut_warm_start). Vertices are vertices of the original graph (BabPbSize
+ * for the last row), so the cuts can be restricted to a subproblem with fewer free variables.
+ */
+typedef struct CutSet {
+    int NIneq, NPentIneq, NHeptaIneq;   // number of stored cuts
+    Triangle_Inequality *Cuts;          // vector (MaxTriIneqAdded)
+    Pentagonal_Inequality *Pent_Cuts;   // vector (MaxPentIneqAdded)
+    Heptagonal_Inequality *Hepta_Cuts;  // vector (MaxHeptaIneqAdded)
+} CutSet;
+
+
+/*
+ * Final point and cuts of an evaluated node, kept with the node until it is branched, so both
+ * children start from them (params.ipm_warm_start, params.cut_warm_start). One allocation:
+ * the matrices and vectors follow the struct.
+ */
+typedef struct NodeWarmStart {
+    size_t bytes;                       // size of the allocation
+    IPMPoint ipm;                       // final point of ipm_mc_pk (ipm.n = 0 if there is none)
+    CutSet cuts;                        // final cuts with their multipliers (none if cut_warm_start = 0)
+} NodeWarmStart;
+
+
+/*
+ * Shared state of one branch-and-bound solve.
+ * Every call of compute() owns its own BabTree, so several solves can run in one process.
+ */
+typedef struct BabTree {
+    BiqBinParameters params;            // BiqBin parameters
+    FILE *output;                       // output file
+    Problem *SP;                        // original problem instance
+    int BabPbSize;                      // number of nodes in original graph - 1 (last variable fixed to 0)
+    BabSolution *BabSol;                // global solution of B&B algorithm
+    _Atomic double BabLB;               // global lower bound (use double since int may overflow!)
+    atomic_int numNodes;                // number of B&B nodes
+    BabNode *BabRoot;                   // root node
+    atomic_int stopped;                 // nonzero if the algorithm stopped early (STOPPED_TIME_LIMIT or STOPPED_MEMORY_LIMIT)
+    double root_bound;                  // SDP upper bound at root node
+    int root_node;                      // indicator for root node (set until the root is evaluated in SDPbound)
+    double diff;                        // difference between basic SDP relaxation and bound with added cutting planes at root
+    double TIME;                        // wall clock time
+
+    /* priority queue: every worker owns one heap */
+    Heap **heaps;
+    int numWorkers;
+    int pending;                        // number of nodes in heaps or currently being processed
+    int epoch;                          // incremented on every insert, guards against lost wake-ups
+    int idleWorkers;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+    pthread_mutex_t lb_lock;            // guards updates of BabLB and BabSol
+
+    /* random number generator of the solve, shared by the workers (see checkpoint.c) */
+    struct random_data rng;
+    char rng_state[2][RNG_STATE_SIZE];  // two buffers: setstate_r overwrites the position in the current one
+    int rng_current;                    // buffer in use
+    pthread_mutex_t rng_lock;
+
+    /* node pools: every worker owns one pool */
+    NodePool *pools;
+    atomic_int liveNodes;               // number of allocated B&B nodes
+    atomic_int peakNodes;               // maximum number of allocated B&B nodes
+    atomic_size_t warmMemory;           // bytes of the starting points kept with open nodes
+    SpillStore *spill;                  // spilled nodes (NULL if params.spill_memory = 0)
+    Checkpoint *checkpoint;             // NULL if params.checkpoint_interval = 0
+    CutPool *cut_pool;                  // NULL if params.cut_pool = 0
+} BabTree;
+
+
+/*
+ * Context of one B&B worker: the shared B&B tree and the bounding workspace
+ * (node specific variables) owned by the worker.
+ */
+typedef struct BiqBinContext {
+    BabTree *tree;                      // shared state of the solve
+    int worker;                         // index of the heap owned by this worker
+    Problem *PP;                        // subproblem instance
+    int *PP_vars;                       // vertex of each row of PP->L (BabPbSize for the last row)
+
+    /* workspace and starting points of ipm_mc_pk */
+    IPMWorkspace *ipm_ws;
+    QPWorkspace *qp_ws;                 // workspace of the bundle master problem
+    CutOperator *cut_op;                // compiled cutting planes (operators B and Bt)
+    IPMPoint *ipm_cur;                  // solution of the last call in the current node
+    const NodeWarmStart *parent;        // starting point of the node being branched (NULL if none)
+
+    /* cutting planes kept for the children (params.cut_warm_start) */
+    CutSet *cuts_cur;                   // final cuts of the current node
+
+    /* PRIMAL variables */
+    double *X;                          // Stores current (psd) X (primal solution). Violated inequalities are computed from X.
+    double *Z;                          // Cholesky factorization: X = ZZ^T (used for heuristic)
+    double **X_bundle;                  // bundle matrices in packed form (MaxBundle + 1 slots, allocated on first use)
+    double *X_packed;                   // packed aggregate of the bundle matrices
+    double *X_test;                     // matching pair X for gamma_test
+
+    /* DUAL variables */
+    double *dual_gamma;                 // (nonnegative) dual multiplier to cutting planes
+    double *dgamma;                     // step direction vector
+    double *gamma_test;
+    double *lambda;                     // vector containing scalars of convex combinations of bundle matrices X_i
+    double *eta;                        // dual multiplier to gamma >= 0 constraint
+    double *F;                          // vector of values <L,X_i>
+    double *g;                          // subgradient
+    double *G;                          // matrix of subgradients (allocated on demand, see Bundle_ReserveG)
+    size_t G_size;                      // number of doubles allocated for G
+
+    double f;                           // objective value of relaxation
+
+    /* hash sets of the current cuts (triangle, pentagonal, heptagonal) */
+    CutHash *cut_hash[3];
+    PoolCut *pool_cuts;                 // vector (params.cut_pool): pool cuts on free vertices taken by CutPool_Probe
+
+    /* Triangle Inequalities variables */
+    Triangle_Inequality *Cuts;          // vector (MaxTriIneqAdded) of current triangle inequality constraints
+    Triangle_Inequality *List;          // vector (params.TriIneq) of new violated triangle inequalities
+    Triangle_Inequality *tri_heaps;     // vector ((params.sep_threads - 1) * params.TriIneq): lists of the other separation threads
+    double *tri_rowmax;                 // vector (N): largest off-diagonal |X_ij| of each row (separation of triangle inequalities)
+
+    /* Pentagonal Inequalities variables */
+    Pentagonal_Inequality *Pent_Cuts;   // vector (MaxPentIneqAdded) of current pentagonal inequality constraints
+    Pentagonal_Inequality *Pent_List;   // vector (3 * params.Pent_Trials) of new violated pentagonal inequalities
+
+    /* Heptagonal Inequalities variables */
+    Heptagonal_Inequality *Hepta_Cuts;  // vector (MaxHeptaIneqAdded) of current heptagonal inequality constraints
+    Heptagonal_Inequality *Hepta_List;  // vector (4 * params.Hepta_Trials) of new violated heptagonal inequalities
+} BiqBinContext;
+
+
 
 /****** BLAS  ******/
 
@@ -158,115 +571,195 @@ extern void dgemv_(char *uplo, int *m, int *n, double *alpha, double *A, int *ld
 extern void dsyr_(char *uplo, int *n, double *alpha, double *x, int *incx, double *A, int *lda);
 
 // level 3 blas
+extern void ssymm_(char *side, char *uplo, int *m, int *n, float *alpha, float *A, int *lda, float *B, int *ldb, float *beta, float *C, int *ldc);
 extern void dsymm_(char *side, char *uplo, int *m, int *n, double *alpha, double *A, int *lda, double *B, int *ldb, double *beta, double *C, int *ldc);
 extern void dsyrk_(char *UPLO, char *TRANS, int *N, int *K, double *ALPHA, double *A, int *LDA, double *BETA, double *C, int *LDC);
+extern void dtrmm_(char *side, char *uplo, char *transa, char *diag, int *m, int *n, double *alpha, double *A, int *lda, double *B, int *ldb);
 
 
 /****** LAPACK  ******/
 
 // computes Cholesky factorization of positive definite matrix
 extern void dpotrf_(char *uplo, int *n, double *X, int *lda, int *info);
+extern void spotrf_(char *uplo, int *n, float *X, int *lda, int *info);
 
 // computes the inverse of a real symmetric positive definite
 // matrix  using the Cholesky factorization  
 extern void dpotri_(char *uplo, int *n, double *X, int *lda, int *info);
+extern void spotri_(char *uplo, int *n, float *X, int *lda, int *info);
 
 // computes solution to a real system of linear equations with symmetrix matrix
 extern void dsysv_(char *uplo, int *n, int *nrhs, double *A, int *lda, int *ipiv, double *B, int *ldb, double *work, int *lwork, int *info);  
 
+// LDL' factorization of a real symmetric matrix and solution of a system with it
+extern void dsytrf_(char *uplo, int *n, double *A, int *lda, int *ipiv, double *work, int *lwork, int *info);
+extern void dsytrs_(char *uplo, int *n, int *nrhs, double *A, int *lda, int *ipiv, double *B, int *ldb, int *info);
+
 // computes solution to a real system of linear equations with positive definite matrix  
 extern void dposv_(char *uplo, int *n, int *nrhs, double *A, int *lda, double *B, int *ldb, int *info);
 
+// solves a system of linear equations using the Cholesky factorization computed by dpotrf
+extern void dpotrs_(char *uplo, int *n, int *nrhs, double *A, int *lda, double *B, int *ldb, int *info);
+extern void spotrs_(char *uplo, int *n, int *nrhs, float *A, int *lda, float *B, int *ldb, int *info);
+
+// computes selected eigenvalues (and eigenvectors) of a real symmetric matrix
+extern void dsyevr_(char *jobz, char *range, char *uplo, int *n, double *A, int *lda, double *vl, double *vu, int *il, int *iu, 
+                    double *abstol, int *m, double *w, double *Z, int *ldz, int *isuppz, double *work, int *lwork, int *iwork, int *liwork, int *info);
+
 
 /**** Declarations of functions per file ****/
 
 /* allocate_free.c */
-void allocMemory(void);
-void freeMemory(void);
+void allocMemory(BiqBinContext *ctx);
+void freeWorkspace(BiqBinContext *ctx);
+void freeMemory(BiqBinContext *ctx);
+size_t workspaceMemory(const BiqBinContext *ctx);
 
 /* bab_functions.c */
-void initializeBabSolution(void);
-void Init_PQ(void);
-void Bab_Init();
-double evaluateSolution(int *sol);
-int updateSolution(int *x);
-void Bab_GenChild(BabNode *node);
+void initializeBabSolution(BiqBinContext *ctx);
+void Init_PQ(BiqBinContext *ctx);
+void Bab_Init(BiqBinContext *ctx);
+void Bab_Resume(BiqBinContext *ctx, const char *path);
+double evaluateSolution(const BiqBinContext *ctx, int *sol);
+int updateSolution(BiqBinContext *ctx, int *x);
+BabNode* Bab_GenChild(BiqBinContext *ctx, BabNode *node);
 double time_wall_clock(void);
-void printSolution(FILE *file);
-void printFinalOutput(FILE *file, int num_nodes);
-void Bab_End(void);
-int getBranchingVariable(BabNode *node);
-int countFixedVariables(BabNode *node);
-int isLeafNode(BabNode *node);
+void printSolution(const BiqBinContext *ctx, FILE *file);
+void printFinalOutput(const BiqBinContext *ctx, FILE *file, int num_nodes);
+void Bab_End(BiqBinContext *ctx);
+int getBranchingVariable(const BiqBinContext *ctx, BabNode *node, const double *fracsol);
+int countFixedVariables(const BabNode *node);
+int isLeafNode(const BiqBinContext *ctx, BabNode *node);
+void Bab_Run(BiqBinContext *ctx, int num_threads);
 
 /* bounding.c */
-double SDPbound(BabNode *node, Problem *SP, Problem *PP);
+double SDPbound(BiqBinContext *ctx, BabNode *node);
 
 /* bundle.c */
-double fct_eval(const Problem *PP, double *gamma, double *X, double *g);
-void solve_lambda(int k, double *Q, double *c, double *lambda);
-void lambda_eta(const Problem *PP, double *zeta, double *G, double *gamma, double *dgamma, double *lambda, double *eta, double *t);
-void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedvalue);
+double fct_eval(const BiqBinContext *ctx, double *gamma, double *X, double *g, double prune_below, int *status);
+void solve_lambda(QPWorkspace *ws, int k, double t, double *c, double *lambda, int warm);
+void lambda_eta(QPWorkspace *ws, const Problem *PP, double *zeta, double *G, double *gamma, double *dgamma, double *lambda, double *eta, double *t);
+void bundle_method(BiqBinContext *ctx, double *t, int bdl_iter, double fixedvalue);
+void Bundle_Store(BiqBinContext *ctx, int i, const double *X);
+void Bundle_Load(const BiqBinContext *ctx, int i, double *X);
+void Bundle_Move(BiqBinContext *ctx, int i, int j);
+void Bundle_GramColumn(BiqBinContext *ctx, int k, int j);
+double *Bundle_ReserveG(BiqBinContext *ctx, int cols);
+void Bundle_NewCuts(BiqBinContext *ctx, int m_old);
 
 /* cutting_planec.c */
+void CutHash_Build(BiqBinContext *ctx, int family);                                  // hash set of the current cuts of family
+int CutHash_Add(BiqBinContext *ctx, int family, int c, int type, const int *p);     // 1 if included, otherwise inserted as cut c
 double evaluateTriangleInequality(double *XX, int N, int type, int ii, int jj, int kk);
-double getViolated_TriangleInequalities(double *X, int N, Triangle_Inequality *List, int *ListSize);
-double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted);
-double getViolated_PentagonalInequalities(double *X, int N, Pentagonal_Inequality *Pent_List, int *ListSize);
-double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted, int triag);
-double getViolated_HeptagonalInequalities(double *X, int N, Heptagonal_Inequality *Hepta_List, int *ListSize);
-double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted, int hept_index);
+double getViolated_TriangleInequalities(const BiqBinContext *ctx, double *X, int N, Triangle_Inequality *List, int *ListSize);
+double updateTriangleInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted);
+double getViolated_PentagonalInequalities(const BiqBinContext *ctx, double *X, int N, Pentagonal_Inequality *Pent_List, int *ListSize);
+double updatePentagonalInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted, int triag);
+double getViolated_HeptagonalInequalities(const BiqBinContext *ctx, double *X, int N, Heptagonal_Inequality *Hepta_List, int *ListSize);
+double updateHeptagonalInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted, int hept_index);
+int loadParentCuts(BiqBinContext *ctx, double *y);
+void storeCuts(BiqBinContext *ctx, const double *y);
 
 /* evaluate.c */
-double Evaluate(BabNode *node, Problem *SP, Problem *PP);
-void createSubproblem(BabNode *node, Problem *SP, Problem *PP);
-double getFixedValue(BabNode *node, Problem *SP);
+double Evaluate(BiqBinContext *ctx, BabNode *node);
+void createSubproblem(const BiqBinContext *ctx, BabNode *node, Problem *SP, Problem *PP);
+double getFixedValue(const BiqBinContext *ctx, BabNode *node, Problem *SP);
 
 /* heap.c */
-double Bab_LBGet(void);                                 // returns global lower bound
-int Bab_numEvalNodes(void);                             // returns number of evaluated nodes
-void Bab_incEvalNodes(void);                            // increment the number of evaluated nodes
-int isPQEmpty(void);                                    // checks if queue is empty
-int Bab_LBUpd(double new_lb, BabSolution *bs);          // checks and updates lower bound if better found, returns 1 if success
-BabNode* newNode(BabNode *parentNode);                  // create child node from parent
-BabNode* Bab_PQPop(void);                               // take and remove the node with the highest priority
-void Bab_PQInsert(BabNode *node);                       // insert node into priority queue based on intbound and level 
-void Bab_LBInit(double lowerBound, BabSolution *bs);    // initialize global lower bound and solution vector
-Heap* Init_Heap(int size);                              // allocates space for heap (array of BabNode*)
+double Bab_LBGet(const BiqBinContext *ctx);                         // returns global lower bound
+int Bab_numEvalNodes(const BiqBinContext *ctx);                     // returns number of evaluated nodes
+void Bab_incEvalNodes(BiqBinContext *ctx);                          // increment the number of evaluated nodes
+int isPQEmpty(BiqBinContext *ctx);                                  // checks if queue is empty
+int Bab_LBUpd(BiqBinContext *ctx, double new_lb, const int *x);    // checks and updates lower bound if better found, returns 1 if success
+BabNode* newNode(const BiqBinContext *ctx, BabNode *parentNode);    // create child node from parent
+void freeNode(const BiqBinContext *ctx, BabNode *node);             // return node to the pool of the worker
+void keepWarmStart(const BiqBinContext *ctx, BabNode *node);        // keep the final point and cuts of the evaluated node for its children
+void getNodeSolution(const BiqBinContext *ctx, const BabNode *node, int *x);    // 0-1 vector of fixed variables (0 if not fixed)
+BabNode* Bab_PQPop(BiqBinContext *ctx);                             // take and remove the node with the highest priority (steals if own heap is empty)
+void Bab_PQNodeDone(BiqBinContext *ctx);                            // signal that the popped node has been processed
+void Bab_PQInsert(BiqBinContext *ctx, BabNode *node);               // insert node into priority queue based on intbound and level 
+void Bab_PQPrune(BiqBinContext *ctx);                               // free nodes that cannot beat the global lower bound
+void Bab_LBInit(BiqBinContext *ctx, double lowerBound, const int *x);  // initialize global lower bound and solution vector
+Heap* Init_Heap(void);                                              // creates empty heap, buckets grow on demand
+void Init_PQ_Workers(BiqBinContext *ctx, int num_workers);          // allocates one heap per worker
+size_t Bab_nodeMemory(const BiqBinContext *ctx);                    // memory used by open B&B nodes in bytes
+double Bab_PQBestBound(BiqBinContext *ctx);                         // highest upper bound in the priority queue
+void Free_PQ_Workers(BiqBinContext *ctx);                           // frees heaps of all workers
+
+/* checkpoint.c */
+void seedRandom(BiqBinContext *ctx, unsigned int seed);             // seed the generator of the solve
+void freeRandom(BiqBinContext *ctx);
+long Bab_random(const BiqBinContext *ctx);                           // next number of the generator (0 .. RAND_MAX)
+void saveRandom(const BiqBinContext *ctx, char *state);
+void restoreRandom(const BiqBinContext *ctx, const char *state);
+void Checkpoint_Init(BiqBinContext *ctx, const char *name);         // checkpoints to <name>.checkpoint if params.checkpoint_interval > 0
+void Checkpoint_Free(BiqBinContext *ctx, int remove_file);
+void Checkpoint_SetCurrent(const BiqBinContext *ctx, const BabNode *node);  // node processed by the worker (NULL if none)
+void Checkpoint_LogNode(const BiqBinContext *ctx, const BabNode *node);     // node inserted while a checkpoint is written
+void Checkpoint_LogRecords(const BiqBinContext *ctx, const char *records, int count);  // node records spilled while a checkpoint is written
+void Checkpoint_Check(BiqBinContext *ctx);                          // write checkpoint if interval has passed
+void Checkpoint_Write(BiqBinContext *ctx);
+void Checkpoint_Read(BiqBinContext *ctx, const char *path);
+
+/* cut_pool.c */
+void CutPool_Init(BiqBinContext *ctx);                              // create the pool if params.cut_pool > 0
+void CutPool_Free(BiqBinContext *ctx);
+size_t CutPool_Memory(const BiqBinParameters *params);              // size of the pool in bytes
+int CutPool_Probe(BiqBinContext *ctx, const double *X);             // add pool cuts violated by X to the node
+void CutPool_Store(BiqBinContext *ctx, const double *y);            // store cuts of the node with y >= 1e-5
+
+/* spill.c */
+size_t nodeRecordSize(int words);                                   // size of compact node record
+void packNode(char *rec, const BabNode *node);
+void unpackNode(const char *rec, BabNode *node);
+void Spill_Init(BiqBinContext *ctx);                                // create spill file if params.spill_memory > 0
+void Spill_Free(BiqBinContext *ctx);
+double Spill_TopBound(const BiqBinContext *ctx);                    // highest upper bound of spilled nodes
+void Spill_Write(BiqBinContext *ctx, BabNode **nodes, int count);   // spill nodes as one segment
+int Spill_Read(BiqBinContext *ctx, BabNode **nodes);                // load segment with the highest bound
+int Spill_Prune(BiqBinContext *ctx, double lowerBound);             // drop segments pruned by lower bound
 
 /* heuristic.c */
-double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x);
-double GW_heuristic(Problem *P0, Problem *P, BabNode *node, int *x, int num);
+double runHeuristic(BiqBinContext *ctx, BabNode *node, int *x);
+double GW_heuristic(BiqBinContext *ctx, BabNode *node, int *x, int num);
 double mc_1opt(int *x, Problem *P0);
-int update_best(int *xbest, int *xnew, double *best, Problem *P0);
+int update_best(const BiqBinContext *ctx, int *xbest, int *xnew, double *best);
 
 /* ipm_mc_pk.c */
-void ipm_mc_pk(double *L, int n, double *X, double *phi, int print);
+int ipm_mc_pk(IPMWorkspace *ws, double *L, int n, double *X, double *y, double *phi, int warm, double prune_below, double keep_above, int print);
+int ipm_solve(const BiqBinContext *ctx, double *L, double *X, double *phi, double prune_below, double keep_above);
 
 /* operators.c */
 void diag(const double *X, double *y, int n);
 void Diag(double *X, const double *y, int n);
-void op_B(const Problem *P, double *y, const double *X);
-void op_Bt(const Problem *P, double *X, const double *tt);
+void CutOp_Update(BiqBinContext *ctx);
+double evaluateCut(const double *X, int N, int family, int type, const int *p);
+void cutKey(int family, int type, const int *p, int *key);             // order-independent key of a cut (width + 1 ints)
+void op_B(const BiqBinContext *ctx, double *y, const double *X);
+void op_B_bundle(const BiqBinContext *ctx, double *const *X_bundle, int k, double *G, int ldg);
+void op_Bt(const BiqBinContext *ctx, double *X, const double *tt);
 
 /* process_input.c */
 void print_symmetric_matrix(double *Mat, int N);
 MaxCutInputData* readGraphFile(const char *instance, MaxCutInputData *inputData);
 BiqBinParameters readParameters(const char *path);
-void setParams(BiqBinParameters params_in);
-void processAdjMatrixSetPP_SP(MaxCutInputData *input_data);
-void openOutputFile(const char *name);
+void setParams(BiqBinContext *ctx, BiqBinParameters params_in);
+void processAdjMatrixSetPP_SP(BiqBinContext *ctx, MaxCutInputData *input_data);
+void openOutputFile(BiqBinContext *ctx, const char *name);
 void printParameters(BiqBinParameters params);
+void writeParameters(FILE *file, BiqBinParameters params);
 void printInputData(MaxCutInputData *input_data);
 void printProblem(const Problem *p);
 void printMatrix(double *Mat, int N);
 void printMatrixSum(double *Mat, int N);
-void printHeader(MaxCutInputData *input_data);
+void printHeader(const BiqBinContext *ctx, MaxCutInputData *input_data);
+void printMemoryEstimate(const BiqBinContext *ctx, int num_workers);
 
 /* qap_simuted_annealing.c */
-double qap_simulated_annealing(int *H, int k, double *X, int n, int *pent);
+double qap_simulated_annealing(const BiqBinContext *ctx, int *H, int k, double *X, int n, int *pent);
 
 /* biqbin.c */
 int compute(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters);
+int compute_resume(MaxCutInputData *MC_input_data, BiqBinParameters biqbin_parameters);
 
 #endif /*BIQBIN_H */
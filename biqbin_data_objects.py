@@ -16,9 +16,22 @@ class BiqBinParameters(ctypes.Structure):
             ('include_Hepta', ctypes.c_int), 
             ('root', ctypes.c_int), 
             ('use_diff', ctypes.c_int), 
+            ('ipm_warm_start', ctypes.c_int), 
+            ('ipm_early_stop', ctypes.c_int), 
+            ('ipm_mixed_precision', ctypes.c_int), 
+            ('cut_warm_start', ctypes.c_int), 
+            ('cut_pool', ctypes.c_int), 
+            ('sep_threads', ctypes.c_int), 
             ('time_limit', ctypes.c_int), 
+            ('memory_limit', ctypes.c_int), 
+            ('spill_memory', ctypes.c_double), 
+            ('checkpoint_interval', ctypes.c_int), 
             ('branchingStrategy', ctypes.c_int), 
+            ('nodeSelection', ctypes.c_int), 
+            ('dive_gap', ctypes.c_double), 
+            ('dive_memory', ctypes.c_int), 
             ('detailedOutput', ctypes.c_int), 
+            ('num_threads', ctypes.c_int), 
         ]
 
 
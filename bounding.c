@@ -1,27 +1,29 @@
 #include "biqbin.h"
 
-extern BiqBinParameters params;
-extern FILE *output;
-extern int BabPbSize;
-
-extern double TIME;                 
-extern Triangle_Inequality *Cuts;            // vector of triangle inequality constraints
-extern Pentagonal_Inequality *Pent_Cuts;     // vector of pentagonal inequality constraints
-extern Heptagonal_Inequality *Hepta_Cuts;    // vector of heptagonal inequality constraints
-
-extern double f;                             // function value of relaxation
-extern double *X;                            // current X
-extern double *X_bundle;                     // current X
-extern double *F;                            // bundle of function values
-extern double *G;                            // bundle of subgradients
-extern double *g;                            // subgradient
-extern double *dual_gamma;                        // dual multiplers for triangle inequalities
-extern double *X_test;
-
-
 /******** main bounding routine calling bundle method ********/
-double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
-    int index;                      // helps to store the fractional solution in the node
+double SDPbound(BiqBinContext *ctx, BabNode *node) {
+
+    BabTree *tree = ctx->tree;
+    const BiqBinParameters *params = &tree->params;
+    FILE *output = tree->output;
+    Problem *SP = tree->SP;
+    Problem *PP = ctx->PP;
+    int BabPbSize = tree->BabPbSize;
+
+    /* bounding workspace of the worker */
+    double *X = ctx->X;
+    double *X_test = ctx->X_test;
+    double *F = ctx->F;
+    double *G = ctx->G;
+    double *g = ctx->g;
+    double *dual_gamma = ctx->dual_gamma;
+    Triangle_Inequality *Cuts = ctx->Cuts;
+    Pentagonal_Inequality *Pent_Cuts = ctx->Pent_Cuts;
+    Heptagonal_Inequality *Hepta_Cuts = ctx->Hepta_Cuts;
+
+    int index;                      // helps to store the fractional solution
+    double fracsol[BabPbSize];      // fractional vector obtained from primal matrix X (last column except last element)
+                                    // used for determining the next branching variable
     double bound;                   // f + fixedvalue
     double gap;                     // difference between best lower bound and upper bound
     double oldf;                    // stores f from previous iteration 
@@ -33,12 +35,11 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
 
     int triag;                      // starting index for pentagonal inequalities in vector gamma
     int penta;                      // starting index for heptagonal inequalities in vector gamma
+    int m_old = 0;                  // number of cuts (rows of G) before separation
 
     int inc = 1;
     int inc_e = 0;
     double e = 1.0;                 // for vector of all ones
-    int nn = PP->n * PP->n;
-    int mk;                         // (PP->NIneq + PP->NPentIneq + PP->NHeptaIneq) * PP->bundle
     
     /* stopping conditions */
     int done = 0;                   
@@ -46,10 +47,10 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
     int prune = 0;
 
     // number of initial iterations of bundle method
-    int bdl_iter = params.init_bundle_iter;                   
+    int bdl_iter = params->init_bundle_iter;                   
 
     // fixed value contributes to the objective value
-    double fixedvalue = getFixedValue(node, SP);
+    double fixedvalue = getFixedValue(ctx, node, SP);
 
     /*** start with no cuts ***/
     // triangle inequalities
@@ -67,79 +68,79 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
     int Hepta_NumAdded = 0;
     int Hepta_NumSubtracted = 0;    
 
-    // indicator for root node
-    static int root_node = 1;  
-
-    // compute diff only in the root node 
+    // compute diff only in the root node (tree->root_node is set until the root is evaluated)
     // diff = difference between basic SDP relaxation and bound with added cutting planes
-    static double diff = 0.0;               
 
-    /* solve basic SDP relaxation with interior-point method */
-    ipm_mc_pk(PP->L, PP->n, X, &f, 0);
+    /* solve basic SDP relaxation with interior-point method 
+     * (may stop early once the pruning or the use_diff condition below is decided) */
+    double keep_above = (params->use_diff && !tree->root_node) ? Bab_LBGet(ctx) + tree->diff + 1.0 - fixedvalue : BIG_NUMBER;
+    ipm_solve(ctx, PP->L, X, &ctx->f, Bab_LBGet(ctx) + 1.0 - fixedvalue, keep_above);
     
     // store basic SDP bound to compute diff in the root node
-    double basic_bound = f + fixedvalue;
+    double basic_bound = ctx->f + fixedvalue;
     
-    // Store the fractional solution in the node    
+    // Store the fractional solution
     index = 0;
     for (int i = 0; i < BabPbSize; ++i) {
-        if (node->xfixed[i]) {
-            node->fracsol[i] = (double) node->sol.X[i];
+        if (Bab_isFixed(node, i)) {
+            fracsol[i] = (double) Bab_solValue(node, i);
         }
         else {
             // convert x (last column X) from {-1,1} to {0,1}
-            node->fracsol[i] = 0.5*(X[(PP->n - 1) + index*PP->n] + 1.0); 
+            fracsol[i] = 0.5*(X[(PP->n - 1) + index*PP->n] + 1.0); 
             ++index;
         }
     }
     
     /* run heuristic */
-    for (int i = 0; i < BabPbSize; ++i) {
-        if (node->xfixed[i]) {
-            x[i] = node->sol.X[i];
-        }
-        else {
-            x[i] = 0;
-        }
-    }
+    getNodeSolution(ctx, node, x);
 
-    runHeuristic(SP, PP, node, x);
-    updateSolution(x);
+    runHeuristic(ctx, node, x);
+    updateSolution(ctx, x);
 
     // upper bound
-    bound = f + fixedvalue;
+    bound = ctx->f + fixedvalue;
 
     // check pruning condition
-    if ( bound < Bab_LBGet() + 1.0 ) {
+    if ( bound < Bab_LBGet(ctx) + 1.0 ) {
         prune = 1;
         goto END;
     }
 
     // check if cutting planes need to be added     
-    if (params.use_diff && !root_node && (bound > Bab_LBGet() + diff + 1.0)) {
+    if (params->use_diff && !tree->root_node && (bound > Bab_LBGet(ctx) + tree->diff + 1.0)) {
         giveup = 1;
         goto END;
     }
 
-    /* separate first triangle inequality */
-    viol3 = updateTriangleInequalities(PP, dual_gamma, &Tri_NumAdded, &Tri_NumSubtracted);
+    /* start with the cuts of the parent node and their multipliers */
+    if (params->cut_warm_start)
+        loadParentCuts(ctx, dual_gamma);
+
+    /* separate first triangle inequality (purges the cuts of the parent with their multipliers) */
+    viol3 = updateTriangleInequalities(ctx, dual_gamma, &Tri_NumAdded, &Tri_NumSubtracted);
+
+    /* add cuts of the global pool that are violated by X (params.cut_pool), 
+     * like separated cuts they are appended with multiplier 0 */
+    CutPool_Probe(ctx, X);
+    CutOp_Update(ctx);
 
     // print output to file
-    if (params.detailedOutput) {
+    if (params->detailedOutput) {
         fprintf(output, "==========================================================================================================================\n");
         fprintf(output, 
             "%14s  %6s  %15s  %9s\n", 
             "starting bound", "cut", "triangles added", "violation");
         fprintf(output, "%14.2f  %6.0lf  %15d  %9.2f\n",
-            bound, Bab_LBGet(), Tri_NumAdded, viol3);
+            bound, Bab_LBGet(ctx), Tri_NumAdded, viol3);
         fprintf(output,"==========================================================================================================================\n");
         fprintf(output, 
                 "%4s  %7s  %9s  %3s  %6s  %5s  %6s  %6s ", 
                 "iter", "time", "bound", "bdl", "viol3", "triag", "purged", "added");
         
-        if (params.include_Pent)
+        if (params->include_Pent)
             fprintf(output, " %6s  %5s  %6s  %6s ", "viol5", "penta", "purged", "added");
-        if (params.include_Hepta)
+        if (params->include_Hepta)
             fprintf(output, " %6s  %5s  %6s  %6s", "viol7", "hepta", "purged", "added");
 
         fprintf(output, "\n==========================================================================================================================\n");
@@ -150,19 +151,34 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
      * Bundle init *
      ***************/
 
-    // set gamma = 0
+    // set gamma = 0 (multipliers of the parent for inherited cuts, 0 for new and pool cuts)
+    int ineq = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
     for (int i = 0; i < PP->NIneq; ++i) {
         dual_gamma[i] = Cuts[i].y;
     }
+    for (int i = 0; i < PP->NPentIneq; ++i)
+        dual_gamma[i + PP->NIneq] = Pent_Cuts[i].y;
+    for (int i = 0; i < PP->NHeptaIneq; ++i)
+        dual_gamma[i + PP->NIneq + PP->NPentIneq] = Hepta_Cuts[i].y;
+
+    int warm = 0;
+    for (int i = 0; i < ineq && !warm; ++i)
+        warm = (dual_gamma[i] != 0.0);
 
     // t = 0.5 * (f - fh) / (PP->NIneq * viol3^2)
-    double t = 0.5 * (bound - Bab_LBGet()) / (PP->NIneq * viol3 * viol3);
+    double t = 0.5 * (bound - Bab_LBGet(ctx)) / (PP->NIneq * viol3 * viol3);
 
     // first evaluation at gamma: f = fct_eval(PP, gamma, X, g)
-    // since gamma = 0, this is just basic SDP relaxation
-    // --> only need to compute subgradient
-    dcopy_(&PP->NIneq, &e, &inc_e, g, &inc);
-    op_B(PP, g, X);
+    if (warm) {
+        int status;
+        ctx->f = fct_eval(ctx, dual_gamma, X, g, -BIG_NUMBER, &status);
+    }
+    else {
+        // since gamma = 0, this is just basic SDP relaxation
+        // --> only need to compute subgradient
+        dcopy_(&ineq, &e, &inc_e, g, &inc);
+        op_B(ctx, g, X);
+    }
 
     /* setup for bundle */
     // F[0] = <L,X>
@@ -179,54 +195,49 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
     }
 
     // G = g
-    dcopy_(&PP->NIneq, g, &inc, G, &inc);
+    G = Bundle_ReserveG(ctx, 1);
+    dcopy_(&ineq, g, &inc, G, &inc);
 
     // include X in X_bundle
-    dcopy_(&nn, X, &inc, X_bundle, &inc);
+    Bundle_Store(ctx, 0, X);
 
     // initialize the bundle counter
     PP->bundle = 1;
+    Bundle_GramColumn(ctx, 1, 0);
 
     /*** Main loop ***/
     while (!done) {
 
         // Update iteration counter
         ++count;
-        oldf = f;
+        oldf = ctx->f;
 
         // Call bundle method
-        bundle_method(PP, &t, bdl_iter, fixedvalue);  
+        bundle_method(ctx, &t, bdl_iter, fixedvalue);  
 
         // upper bound
-        bound = f + fixedvalue;
+        bound = ctx->f + fixedvalue;
 
         // prune test
-        prune = ( bound < Bab_LBGet() + 1.0 ) ? 1 : 0;
+        prune = ( bound < Bab_LBGet(ctx) + 1.0 ) ? 1 : 0;
 
         /******** heuristic ********/
         if (!prune) {
 
-            for (int i = 0; i < BabPbSize; ++i) {
-                if (node->xfixed[i]) {
-                    x[i] = node->sol.X[i];
-                }
-                else {
-                    x[i] = 0;
-                }
-            }
+            getNodeSolution(ctx, node, x);
 
-            runHeuristic(SP, PP, node, x);
-            updateSolution(x);
+            runHeuristic(ctx, node, x);
+            updateSolution(ctx, x);
 
-            prune = ( bound < Bab_LBGet() + 1.0 ) ? 1 : 0;
+            prune = ( bound < Bab_LBGet(ctx) + 1.0 ) ? 1 : 0;
         }
         /***************************/
 
         // compute gap
-        gap = bound - Bab_LBGet();
+        gap = bound - Bab_LBGet(ctx);
         
         // check if we stop the bounding routine
-        if ( (count == params.max_outer_iter) || (count >= params.min_outer_iter && (gap - 1.0 > (oldf - f)*(params.max_outer_iter - count))))
+        if ( (count == params->max_outer_iter) || (count >= params->min_outer_iter && (gap - 1.0 > (oldf - ctx->f)*(params->max_outer_iter - count))))
                 giveup = 1;
 
 
@@ -237,18 +248,34 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
             penta = PP->NPentIneq;      // --> to know with which index in dual vector gamma, pentagonal
                                         // and heptagonal inequalities start!
 
-            viol3 = updateTriangleInequalities(PP, dual_gamma, &Tri_NumAdded, &Tri_NumSubtracted);
+            // rows of the cuts in G (new cuts get row -1)
+            m_old = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+            for (int i = 0; i < PP->NIneq; ++i)
+                Cuts[i].row = i;
+            for (int i = 0; i < PP->NPentIneq; ++i)
+                Pent_Cuts[i].row = PP->NIneq + i;
+            for (int i = 0; i < PP->NHeptaIneq; ++i)
+                Hepta_Cuts[i].row = PP->NIneq + PP->NPentIneq + i;
+
+            // multipliers of pentagonal and heptagonal inequalities (the update functions
+            // below are not called for them if viol3 >= 0.3, but gamma is rebuilt from the cuts)
+            for (int i = 0; i < PP->NPentIneq; ++i)
+                Pent_Cuts[i].y = dual_gamma[PP->NIneq + i];
+            for (int i = 0; i < PP->NHeptaIneq; ++i)
+                Hepta_Cuts[i].y = dual_gamma[PP->NIneq + PP->NPentIneq + i];
+
+            viol3 = updateTriangleInequalities(ctx, dual_gamma, &Tri_NumAdded, &Tri_NumSubtracted);
                       
             /* include pentagonal and heptagonal inequalities */          
             if ( viol3 < 0.3 )
             {
-                if ( params.include_Pent ) {
-                    viol5 = updatePentagonalInequalities(PP, dual_gamma, &Pent_NumAdded, &Pent_NumSubtracted, triag);  
+                if ( params->include_Pent ) {
+                    viol5 = updatePentagonalInequalities(ctx, dual_gamma, &Pent_NumAdded, &Pent_NumSubtracted, triag);  
                 }
-                if ( params.include_Hepta ) {
+                if ( params->include_Hepta ) {
                     if (penta == 0)
                         penta = PP->NPentIneq;
-                    viol7 = updateHeptagonalInequalities(PP, dual_gamma, &Hepta_NumAdded, &Hepta_NumSubtracted, triag + penta);        
+                    viol7 = updateHeptagonalInequalities(ctx, dual_gamma, &Hepta_NumAdded, &Hepta_NumSubtracted, triag + penta);        
                 }
             }
                 
@@ -263,15 +290,15 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
         }
 
         // print output to file
-        if (params.detailedOutput) {
+        if (params->detailedOutput) {
             fprintf(output, 
                     "%4d  %7.2f  %9.2f  %3d  %6.0e  %5d    -%-5d +%-5d ", 
-                    count, time_wall_clock() - TIME, bound, PP->bundle, viol3, PP->NIneq, Tri_NumSubtracted, Tri_NumAdded);
+                    count, time_wall_clock() - tree->TIME, bound, PP->bundle, viol3, PP->NIneq, Tri_NumSubtracted, Tri_NumAdded);
 
             if ( viol3 < 0.3 ) {
-                if ( params.include_Pent )
+                if ( params->include_Pent )
                     fprintf(output, "%6.0e  %5d    -%-5d +%-5d ", 1.0 - viol5, PP->NPentIneq, Pent_NumSubtracted, Pent_NumAdded);
-                if ( params.include_Hepta )
+                if ( params->include_Hepta )
                     fprintf(output, "%6.0e  %5d    -%-5d +%-5d", 1.0 - viol7, PP->NHeptaIneq, Hepta_NumSubtracted, Hepta_NumAdded);
             }
 
@@ -284,15 +311,15 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
             prune ||                       // can prune the B&B tree 
             giveup;                        // upper bound to far away from lower bound
 
-        // Store the fractional solution in the node    
+        // Store the fractional solution
         index = 0;
         for (int i = 0; i < BabPbSize; ++i) {
-            if (node->xfixed[i]) {
-                node->fracsol[i] = (double) node->sol.X[i];
+            if (Bab_isFixed(node, i)) {
+                fracsol[i] = (double) Bab_solValue(node, i);
             }
             else {
                 // convert x (last column X) from {-1,1} to {0,1}
-                node->fracsol[i] = 0.5*(X[(PP->n - 1) + index*PP->n] + 1.0); 
+                fracsol[i] = 0.5*(X[(PP->n - 1) + index*PP->n] + 1.0); 
                 ++index;
             }
         }
@@ -312,21 +339,23 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
                 dual_gamma[i + PP->NIneq + PP->NPentIneq] = Hepta_Cuts[i].y;
 
 
-            fct_eval(PP, dual_gamma, X_test, g);
+            // compile new cuts into operators B and Bt
+            CutOp_Update(ctx);
+
+            int status;
+            fct_eval(ctx, dual_gamma, X_test, g, -BIG_NUMBER, &status);
 
             // G
             /* for i = 1:k
              *      G(:,i) = b - A*X(:,i);
              * end
+             * (only rows of new cuts are computed, see Bundle_NewCuts)
              */ 
-            mk = (PP->NIneq + PP->NPentIneq + PP->NHeptaIneq) * PP->bundle;
-            dcopy_(&mk, &e, &inc_e, G, &inc); // fill G with 1
-            for (int i = 0; i < PP->bundle; ++i) {
-                op_B(PP, G + i*(PP->NIneq + PP->NPentIneq + PP->NHeptaIneq), X_bundle + i * nn );
-            }
+            Bundle_NewCuts(ctx, m_old);
 
             // add g to G
-            int ineq = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+            ineq = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+            G = Bundle_ReserveG(ctx, PP->bundle + 1);
             dcopy_(&ineq, g, &inc, G + PP->bundle * (PP->NIneq + PP->NPentIneq + PP->NHeptaIneq), &inc);
 
             // add <L, X> to F
@@ -343,7 +372,8 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
             }
 
             // add X to X_bundle
-            dcopy_(&nn, X_test, &inc, X_bundle + PP->bundle * nn, &inc);
+            Bundle_Store(ctx, PP->bundle, X_test);
+            Bundle_GramColumn(ctx, PP->bundle + 1, PP->bundle);
 
             // Check bundle size for overflow (can not append more)
             if (PP->bundle == MaxBundle) {
@@ -360,24 +390,29 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
 
         /* increase number of bundle iterations */
         ++bdl_iter;
-        bdl_iter = (bdl_iter  < params.max_bundle_iter) ? bdl_iter  : params.max_bundle_iter;
+        bdl_iter = (bdl_iter  < params->max_bundle_iter) ? bdl_iter  : params->max_bundle_iter;
 
 
     } // end while loop
 
-    bound = f + fixedvalue;
+    bound = ctx->f + fixedvalue;
 
     // compute difference between basic SDP relaxation and bound with added cutting planes
     // use diff: add cutting planes at every B&B node or only when sufficiently close to upper bound
     // NOTE: by default params.use_diff is set to true because B&B is traversed faster!
-    if (root_node) {
-        diff = basic_bound - bound;
-        root_node = 0;
+    if (tree->root_node) {
+        tree->diff = basic_bound - bound;
+        tree->root_node = 0;
     }
 
 
     END:
-    if (params.detailedOutput) {
+    // keep the cuts for the children
+    if (params->cut_warm_start)
+        storeCuts(ctx, dual_gamma);
+    CutPool_Store(ctx, dual_gamma);
+
+    if (params->detailedOutput) {
         fprintf(output, "==========================================================================================================================\n");
         if (prune) {
             fprintf(output, "Prune!\n");
@@ -388,6 +423,10 @@ double SDPbound(BabNode *node, Problem *SP, Problem *PP) {
         fprintf(output, "==========================================================================================================================\n");
     }    
 
+    // only the branching variable is kept in the node (not the whole fractional solution)
+    node->branch_var = getBranchingVariable(ctx, node, fracsol);
+    node->branch_frac = (float) fracsol[node->branch_var];
+
     return bound;
 
 }
@@ -2,30 +2,256 @@
 
 #define ABS(i) ((i)>0 ? (i) : -(i))
 
+
+/*
+ * Bundle matrices X_i are stored in packed upper triangular form (column by column, n(n+1)/2
+ * entries). Slots are allocated on first use for the size of the original problem and kept
+ * for later nodes, so memory depends on the largest bundle that is used and not on MaxBundle.
+ * Purging the bundle moves pointers instead of copying matrices.
+ */
+
+/* store X in bundle slot i */
+void Bundle_Store(BiqBinContext *ctx, int i, const double *X) {
+
+    int n = ctx->PP->n;
+    int N = ctx->tree->SP->n;
+
+    if (ctx->X_bundle[i] == NULL) {
+        alloc_vector(ctx->X_bundle[i], (size_t) N * (N + 1) / 2, double);
+    }
+
+    double *P = ctx->X_bundle[i];
+    for (int j = 0; j < n; ++j)
+        for (int r = 0; r <= j; ++r)
+            *P++ = X[r + j * n];
+}
+
+
+/* unpack symmetric matrix X from packed P */
+static void unpack(const double *P, double *X, int n) {
+
+    for (int j = 0; j < n; ++j)
+        for (int r = 0; r <= j; ++r, ++P)
+            X[r + j * n] = X[j + r * n] = *P;
+}
+
+
+/* X = bundle matrix i */
+void Bundle_Load(const BiqBinContext *ctx, int i, double *X) {
+    unpack(ctx->X_bundle[i], X, ctx->PP->n);
+}
+
+
+/* move bundle matrix from slot i to slot j (the matrix in slot j is discarded) */
+void Bundle_Move(BiqBinContext *ctx, int i, int j) {
+
+    double *tmp = ctx->X_bundle[j];
+
+    ctx->X_bundle[j] = ctx->X_bundle[i];
+    ctx->X_bundle[i] = tmp;
+}
+
+
+/*
+ * The subgradients G (m rows, one column per bundle element) are allocated on demand as
+ * well: make room for columns 0..cols-1 with the current number of cuts and return G.
+ * G grows geometrically and keeps its content, so pointers to G have to be taken again.
+ */
+double *Bundle_ReserveG(BiqBinContext *ctx, int cols) {
+
+    const Problem *PP = ctx->PP;
+    size_t size = (size_t) (PP->NIneq + PP->NPentIneq + PP->NHeptaIneq) * cols;
+
+    if (size > ctx->G_size) {
+        size_t grow = (size > 2 * ctx->G_size) ? size : 2 * ctx->G_size;
+        ctx->G = (double *) realloc(ctx->G, grow * sizeof(double));
+        if (ctx->G == NULL) {
+            fprintf(stderr, "Error: Not enough memory for the bundle of subgradients.\n");
+            exit(1);
+        }
+        ctx->G_size = grow;
+    }
+
+    return ctx->G;
+}
+
+
+/* X = sum_i lambda[i] * X_i (over the k bundle matrices) */
+static void Bundle_Aggregate(BiqBinContext *ctx, const double *lambda, int k, double *X) {
+
+    int n = ctx->PP->n;
+    int len = n * (n + 1) / 2;
+    int inc = 1;
+    double *P = ctx->X_packed;
+
+    for (int j = 0; j < len; ++j)
+        P[j] = 0.0;
+
+    for (int i = 0; i < k; ++i)
+        daxpy_(&len, (double *) &lambda[i], ctx->X_bundle[i], &inc, P, &inc);
+
+    unpack(P, X, n);
+}
+
+
+/*
+ * G'*G (lower triangle) is kept in ctx->qp_ws->GtG and updated together with G: columns
+ * for new bundle elements, compaction when the bundle is purged and rank one updates for
+ * rows of purged and new cuts after separation. lambda_eta then needs no O(m k^2) product.
+ */
+
+/* column j of G'*G for the first k bundle elements */
+void Bundle_GramColumn(BiqBinContext *ctx, int k, int j) {
+
+    const Problem *PP = ctx->PP;
+    double *GtG = ctx->qp_ws->GtG;
+    double *G = ctx->G;
+    int m = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+    int ld = MaxBundle;
+    int inc = 1;
+    int len;
+    char TRANS = 'T';
+    double alpha = 1.0;
+    double beta = 0.0;
+
+    if (m == 0) {
+        for (int i = 0; i < k; ++i)
+            GtG[(i >= j) ? i + j * ld : j + i * ld] = 0.0;
+        return;
+    }
+
+    // lower part of column j: G(:,j:k-1)' * G(:,j)
+    len = k - j;
+    dgemv_(&TRANS, &m, &len, &alpha, G + (size_t) m * j, &m, G + (size_t) m * j, &inc, &beta, GtG + j + j * ld, &inc);
+
+    // row j left of the diagonal: G(:,0:j-1)' * G(:,j)
+    if (j > 0)
+        dgemv_(&TRANS, &m, &j, &alpha, G, &m, G + (size_t) m * j, &inc, &beta, GtG + j, &ld);
+}
+
+
+/* keep bundle elements cols[0..k-1] (nondecreasing) of G'*G in this order */
+static void gram_compact(QPWorkspace *ws, int k) {
+
+    int ld = MaxBundle;
+
+    for (int b = 0; b < k; ++b)
+        for (int a = b; a < k; ++a)
+            ws->GtG[a + b * ld] = ws->GtG[ws->cols[a] + ws->cols[b] * ld];
+}
+
+
+/* row of the cut with index r in gamma before separation (-1 for new cuts) */
+static int cut_row(const BiqBinContext *ctx, int r) {
+
+    const Problem *PP = ctx->PP;
+
+    if (r < PP->NIneq)
+        return ctx->Cuts[r].row;
+    r -= PP->NIneq;
+    if (r < PP->NPentIneq)
+        return ctx->Pent_Cuts[r].row;
+    return ctx->Hepta_Cuts[r - PP->NPentIneq].row;
+}
+
+
+/*
+ * Update G and G'*G after separation (G has the m_old rows of the previous cuts).
+ * Rows of kept cuts are moved, rows of purged cuts are dropped and only the rows of
+ * new cuts are computed from the bundle matrices (op_B_bundle). G is compacted in place one column
+ * at a time (in increasing order if it shrinks and in decreasing order if it grows,
+ * so no column is overwritten before it is read). G'*G gets rank one updates for the
+ * purged and new rows, or is recomputed if that is cheaper.
+ */
+void Bundle_NewCuts(BiqBinContext *ctx, int m_old) {
+
+    const Problem *PP = ctx->PP;
+    QPWorkspace *ws = ctx->qp_ws;
+    int m = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+    int k = PP->bundle;
+    double *G = Bundle_ReserveG(ctx, k);
+    int ld = MaxBundle;
+    int inc = 1;
+    int kept = 0;
+    char UPLO = 'L';
+    char TRANS = 'T';
+    double alpha, beta;
+
+    for (int r = 0; r < m_old; ++r)
+        ws->rows[r] = 0;
+
+    for (int r = 0; r < m; ++r) {
+        ws->prev[r] = cut_row(ctx, r);
+        if (ws->prev[r] >= 0) {
+            ws->rows[ws->prev[r]] = 1;
+            ++kept;
+        }
+    }
+
+    // rank one updates for purged and new rows, unless recomputing G'G is cheaper
+    int incremental = ((m_old - kept) + (m - kept) < m);
+
+    /* G'G: remove rows of purged cuts */
+    if (incremental) {
+        alpha = -1.0;
+        for (int r = 0; r < m_old; ++r)
+            if (!ws->rows[r])
+                dsyr_(&UPLO, &k, &alpha, G + r, &m_old, ws->GtG, &ld);
+    }
+
+    /* G: move kept rows */
+    for (int c = 0; c < k; ++c) {
+
+        int i = (m <= m_old) ? c : k - 1 - c;
+
+        for (int r = 0; r < m; ++r)
+            ws->col[r] = (ws->prev[r] >= 0) ? G[ws->prev[r] + (size_t) i * m_old] : 1.0;
+
+        dcopy_(&m, ws->col, &inc, G + (size_t) i * m, &inc);
+    }
+
+    /* G: rows of new cuts for all bundle matrices at once */
+    if (kept < m)
+        op_B_bundle(ctx, ctx->X_bundle, k, G, m);
+
+    /* G'G: add rows of new cuts */
+    alpha = 1.0;
+    if (incremental) {
+        for (int r = 0; r < m; ++r)
+            if (ws->prev[r] < 0)
+                dsyr_(&UPLO, &k, &alpha, G + r, &m, ws->GtG, &ld);
+    }
+    else {
+        beta = 0.0;
+        dsyrk_(&UPLO, &TRANS, &k, &m, &alpha, G, &m, &beta, ws->GtG, &ld);
+    }
+}
+
+
 /******************** Bundle method *********************/
 /* Bundle method for solving Max-Cut SDP relaxation
  * strengthened with cutting planes.
  ******************************************************/
-void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
-
-    extern double f;                // opt. value of SDP 
-    extern double *g;               // subgradient 
-    extern double *X;               // primal matrix X
-    extern double *X_test;          
-    extern double *X_bundle;        // bundle of matrices Xi
-    extern double *F;               // bundle of <L,Xi>
-    extern double *G;               // bundle of gradients
-    extern double *dual_gamma;           // dual variable to cutting plane inequalities
-    extern double *dgamma;          // step vector for gamma
-    extern double *gamma_test;      
-    extern double *lambda;          // contains scalars of convex combinations of bundle matrices
-    extern double *eta;             // dual variable to gamma >= 0 constraint 
+void bundle_method(BiqBinContext *ctx, double *t, int bdl_iter, double fixedValue) {
+
+    Problem *PP = ctx->PP;                  // current subproblem
+    double *g = ctx->g;                     // subgradient 
+    double *X = ctx->X;                     // primal matrix X
+    double *X_test = ctx->X_test;          
+    double *F = ctx->F;                     // bundle of <L,Xi>
+    double *G = ctx->G;                     // bundle of gradients
+    double *dual_gamma = ctx->dual_gamma;   // dual variable to cutting plane inequalities
+    double *dgamma = ctx->dgamma;           // step vector for gamma
+    double *gamma_test = ctx->gamma_test;      
+    double *lambda = ctx->lambda;           // contains scalars of convex combinations of bundle matrices
+    double *eta = ctx->eta;                 // dual variable to gamma >= 0 constraint 
+    double *zeta = ctx->qp_ws->zeta;        // -F - G'*gamma
+    double f = ctx->f;                      // opt. value of SDP 
 
     // number of cutting planes
     int m = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq; 
          
     int k;                                  // bundle size
-    int nn = PP->n * PP->n;     
     double alpha, beta;                     // variables in blas/lapack routines
     int inc = 1;
     char TRANS;
@@ -37,10 +263,7 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
     int subtracted, next_bundle;            // for purging of the bundle    
     double temp; 
     int bdl_cnt = 0;                        // number of iterations of bundle method
-
-    // allocate memory
-    double *zeta;
-    alloc_vector(zeta, MaxBundle, double);
+    int status;                             // result of fct_eval
 
 
     /***** main loop *****/
@@ -63,14 +286,20 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
         dgemv_(&TRANS, &m, &k, &alpha, G, &m, dual_gamma, &inc, &beta, zeta, &inc);
 
         /*** solve QP ***/
-        lambda_eta(PP, zeta, G, dual_gamma, dgamma, lambda, eta, t);
+        lambda_eta(ctx->qp_ws, PP, zeta, G, dual_gamma, dgamma, lambda, eta, t);
 
         /*** make a step: gamma_test = gamma + dgamma; ***/
         for (int i = 0; i < m; ++i)
             gamma_test[i] = dual_gamma[i] + dgamma[i];
 
         /*** evaluate function at gamma_test ***/
-        f_test = fct_eval(PP, gamma_test, X_test, g);
+        f_test = fct_eval(ctx, gamma_test, X_test, g, Bab_LBGet(ctx) + 1.0 - fixedValue, &status);
+
+        // f_test is an upper bound that prunes the node (X_test and g are not accurate)
+        if (status == IPM_PRUNE) {
+            f = f_test;
+            break;
+        }
 
         /* del = f - f_appr(gamma_test) = f - (F'lambda + gamma_test'*G*lambda) */
         dcopy_(&k, F, &inc, zeta, &inc); // copy F into zeta
@@ -102,10 +331,7 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
              * --> retrive X from lambda and bundle matrices 
              * X = X_bundle * lambda
              ***/
-            alpha = 1.0;
-            beta = 0.0;
-            TRANS = 'N';
-            dgemv_(&TRANS, &nn, &k, &alpha, X_bundle, &nn, lambda, &inc, &beta, X, &inc);
+            Bundle_Aggregate(ctx, lambda, k, X);
             
 
             // update t
@@ -126,8 +352,9 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
                     if (i > next_bundle) {
                         F[next_bundle] = F[i];
                         dcopy_(&m, G + m*i, &inc, G + m*next_bundle, &inc);
-                        dcopy_(&nn, X_bundle + nn*i, &inc, X_bundle + nn*next_bundle, &inc);
+                        Bundle_Move(ctx, i, next_bundle);
                     }
+                    ctx->qp_ws->cols[next_bundle] = i;
                         
                     ++next_bundle;
                 }
@@ -135,6 +362,7 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
 
             // update bundle count
             PP->bundle -= subtracted;
+            gram_compact(ctx->qp_ws, PP->bundle);
 
             // Check bundle size for overflow (can not append more)
             if (PP->bundle == MaxBundle) {
@@ -146,8 +374,10 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
             /* G = [G g]
              * X = [X X_test(:)]
              * F = [F L(:)'*X_test(:)] */
+            G = Bundle_ReserveG(ctx, PP->bundle + 1);
             dcopy_(&m, g, &inc, G + m * PP->bundle, &inc);
-            dcopy_(&nn, X_test, &inc, X_bundle + nn * PP->bundle, &inc);
+            Bundle_Store(ctx, PP->bundle, X_test);
+            Bundle_GramColumn(ctx, PP->bundle + 1, PP->bundle);
 
             temp = 0.0;
             for (int i = 0; i < PP->n; ++i) {
@@ -166,7 +396,7 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
             ++(PP->bundle);
 
             // check pruning condition
-            if (f + fixedValue < Bab_LBGet() + 1.0)
+            if (f + fixedValue < Bab_LBGet(ctx) + 1.0)
                 break;
 
         }
@@ -190,8 +420,9 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
                     if (i > next_bundle) {
                         F[next_bundle] = F[i];
                         dcopy_(&m, G + m*i, &inc, G + m*next_bundle, &inc);
-                        dcopy_(&nn, X_bundle + nn*i, &inc, X_bundle + nn*next_bundle, &inc);
+                        Bundle_Move(ctx, i, next_bundle);
                     }
+                    ctx->qp_ws->cols[next_bundle] = i;
                             
                     ++next_bundle;
                 }
@@ -212,12 +443,18 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
 
             // first copy G(:,k), X(:,k) and F(:,k) into right position
             F[PP->bundle] = F[k-1];
+            G = Bundle_ReserveG(ctx, PP->bundle + 1);
             dcopy_(&m, G + m * (k-1), &inc, G + m * PP->bundle, &inc);
-            dcopy_(&nn, X_bundle + nn * (k-1), &inc, X_bundle + nn * PP->bundle, &inc);
+            Bundle_Move(ctx, k-1, PP->bundle);
+            // (position PP->bundle-1 is filled with g below)
+            ctx->qp_ws->cols[PP->bundle-1] = k-1;
+            ctx->qp_ws->cols[PP->bundle] = k-1;
+            gram_compact(ctx->qp_ws, PP->bundle + 1);
 
             // add g, X_test and L(:)'*X_test(:)
             dcopy_(&m, g, &inc, G + m * (PP->bundle-1), &inc);
-            dcopy_(&nn, X_test, &inc, X_bundle + nn * (PP->bundle-1), &inc);
+            Bundle_Store(ctx, PP->bundle-1, X_test);
+            Bundle_GramColumn(ctx, PP->bundle + 1, PP->bundle-1);
 
             temp = 0.0;
             for (int i = 0; i < PP->n; ++i) {
@@ -238,13 +475,14 @@ void bundle_method(Problem *PP, double *t, int bdl_iter, double fixedValue) {
         }    
     }   
 
-    free(zeta);
-
+    ctx->f = f;
 }
 
 /*** evaluate dual function: compute its value f and subgradient g ***/
-double fct_eval(const Problem *PP, double *gamma, double *X, double *g) {
+/* the evaluation stops early (status IPM_PRUNE) if f is proved to be below prune_below */
+double fct_eval(const BiqBinContext *ctx, double *gamma, double *X, double *g, double prune_below, int *status) {
 
+    const Problem *PP = ctx->PP;
     int n = PP->n;
     int m = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
     int nn = n * n;
@@ -252,15 +490,19 @@ double fct_eval(const Problem *PP, double *gamma, double *X, double *g) {
     double f;   // function value
  
     /* L0 = L - A^T(gamma) */
-    double *L0;
-    alloc_matrix(L0, n, double);
+    double *L0 = ctx->ipm_ws->L0;
     dcopy_(&nn, PP->L, &inc, L0, &inc);
 
     if (m > 0)
-        op_Bt(PP, L0, gamma);
+        op_Bt(ctx, L0, gamma);
+
+    /* f = phi + sum(gamma) */
+    double sum_gamma = 0.0;
+    for (int i = 0; i < m; ++i)
+        sum_gamma += gamma[i];
 
     /* solve basic SDP relaxation */
-    ipm_mc_pk(L0, n, X, &f, 0);
+    *status = ipm_solve(ctx, L0, X, &f, prune_below - sum_gamma, BIG_NUMBER);
 
     if (m > 0) {
         /* compute function value f: add sum(gamma) 
@@ -270,11 +512,9 @@ double fct_eval(const Problem *PP, double *gamma, double *X, double *g) {
             g[i] = 1.0; 
         }
 
-        op_B(PP, g, X);
+        op_B(ctx, g, X);
     }
 
-    free(L0);
-
     return f;
 }
 
@@ -282,6 +522,7 @@ double fct_eval(const Problem *PP, double *gamma, double *X, double *g) {
 /* Solve lambda-eta problem
  *
  * INPUT:
+ *          ws ... G'*G and storage of the QP solver
  *          PP ... current subproblem
  *        zeta ... -F - G'*gamma;
  *           G ... subgradients
@@ -293,7 +534,7 @@ double fct_eval(const Problem *PP, double *gamma, double *X, double *g) {
  * lambda, eta ... solutions of QP
  *           t ... penalty parameter in the bundle method
  */
-void lambda_eta(const Problem *PP, double *zeta, double *G, double *gamma, double *dgamma, double *lambda, double *eta, double *t) {
+void lambda_eta(QPWorkspace *ws, const Problem *PP, double *zeta, double *G, double *gamma, double *dgamma, double *lambda, double *eta, double *t) {
 
     int m = PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;      // number of inequalities
     int k = PP->bundle;                     // size of bundle
@@ -307,22 +548,14 @@ void lambda_eta(const Problem *PP, double *zeta, double *G, double *gamma, doubl
     for (int i = 0; i < m; ++i)
         eta[i] = 0.0;
 
-    double *Q;
-    alloc_matrix(Q, k, double);
-
-    /* compute Q = t*(G'*G) */
-    char UPLO = 'L';
-    char TRANS = 'T';
-    double beta = 0.0;
-    double alpha = *t;
-
-    dsyrk_(&UPLO, &TRANS, &k, &m, &alpha, G, &m, &beta, Q, &k);
-
-    /* allocate variables */
-    double *tmp, *c;
+    double *tmp = ws->tmp;
+    double *c = ws->c;
+    char TRANS;
+    double alpha, beta;
 
-    alloc_vector(tmp, m, double);
-    alloc_vector(c, k, double);
+    /* QP matrix is t*G'*G, G'*G is kept up to date by the bundle updates */
+    // bundle or t changed: factorization of the previous call is not valid
+    ws->factored = 0;
 
     /*************
      * main loop *
@@ -339,8 +572,8 @@ void lambda_eta(const Problem *PP, double *zeta, double *G, double *gamma, doubl
         beta = 1.0;
         dgemv_(&TRANS, &m, &k, &alpha, G, &m, eta, &inc, &beta, c, &inc);
 
-        /* solve QP */
-        solve_lambda(k,Q,c,lambda);
+        /* solve QP (warm start from lambda of the previous iteration) */
+        solve_lambda(ws, k, *t, c, lambda, cnt > 1);
 
         /* compute tmp = G*lambda */
         TRANS = 'N';
@@ -370,289 +603,183 @@ void lambda_eta(const Problem *PP, double *zeta, double *G, double *gamma, doubl
         
         dir_prev = dir_curr;
     }
-
-    free(tmp);
-    free(c);
-    free(Q);
 }
 
 
+/*
+ * LDL' factorization (dsytrf) of the KKT matrix [Q_FF e; e' 0] of the free indices ws->idx.
+ * Q = t*G'*G can be singular (e.g. for k > m), so a small multiple of the identity is
+ * added to Q_FF (and increased if the KKT matrix is still singular).
+ */
+static void factor_free(QPWorkspace *ws, int k, double t) {
+
+    int nf = ws->nfree;
+    int size = nf + 1;
+    int ld = MaxBundle;
+    char UPLO = 'L';
+    int INFO;
+    double qmax = 0.0;
+
+    for (int i = 0; i < k; ++i)
+        qmax = (t * ws->GtG[i * (ld + 1)] > qmax) ? t * ws->GtG[i * (ld + 1)] : qmax;
+
+    double shift = 1e-10 * (1.0 + qmax);
+
+    do {
+        for (int b = 0; b < nf; ++b) {
+            for (int a = b; a < nf; ++a) {
+                // idx is increasing, so (idx[a], idx[b]) is in the lower triangle of G'*G
+                ws->K[a + b * size] = t * ws->GtG[ws->idx[a] + ws->idx[b] * ld];
+            }
+            ws->K[b + b * size] += shift;
+            ws->K[nf + b * size] = 1.0;
+        }
+        ws->K[nf + nf * size] = 0.0;
+
+        dsytrf_(&UPLO, &size, ws->K, &size, ws->ipiv, ws->work, &ws->lwork, &INFO);
+        shift *= 100.0;
+    } while (INFO > 0);
+
+    ws->factored = 1;
+}
+
 
 /*
  * solves
  * (QP)  min <lambda,c> + 1/2 <lambda, Q lambda>
  *        s.t. sum(lambda_i) = 1, lambda >= 0.
  * 
- * input: Q, c, k
+ * input: Q = t * ws->GtG, c, k, warm (lambda is a feasible starting point)
  * output: lambda ... optimal solution point
  *
- * dual: 
- * (D)   max y - 1/2 <lambda, Q lambda>
- *       s.t. z = c + Q lambda - e y           
- *       lambda >= 0, z >=0 , y free
+ * Primal active set method: indices with lambda_i > 0 are free, the others are fixed
+ * to 0. Each iteration solves the equality constrained problem on the free indices.
+ * The factorization of its KKT matrix is kept in ws as long as the free set does not
+ * change (also between calls in the lambda_eta loop, where only c changes). Bundles
+ * are small and lambda is sparse, so it is cheap to recompute when the set changes.
  */
-void solve_lambda(int k, double *Q, double *c, double *lambda) {
+void solve_lambda(QPWorkspace *ws, int k, double t, double *c, double *lambda, int warm) {
 
-    // BLAS/LAPACK variables
     int inc = 1;
-    int inc_e = 0;
+    int ld = MaxBundle;
     char UPLO = 'L';
-    double e = 1.0;     // for vector with all ones when calling ddot_
+    double beta = 1.0;
     int INFO;
 
-    double temp;
-    int cnt = 0;        // iteration counter
-
-    /*** starting triplet ***/
+    double *GtG = ws->GtG;
+    double *grad = ws->grad;    // gradient Q*lambda + c
+    double *p = ws->p;          // step on the free indices and multiplier of sum(p) = 0
+    int *idx = ws->idx;         // free indices
+    int nf;
+
+    /* starting point: previous lambda or the vertex with the smallest objective value */
+    if (!warm) {
+        int best = 0;
+        for (int i = 1; i < k; ++i)
+            if (c[i] + 0.5 * t * GtG[i * (ld + 1)] < c[best] + 0.5 * t * GtG[best * (ld + 1)])
+                best = i;
     
-    // lambda = e/k
-    for (int i = 0; i < k; ++i)
-        lambda[i] = 1.0/k;
-
-    // Qlam = Q*lam
-    double *Qlam;
-    alloc_vector(Qlam, k, double);
-
-    double alpha = 1.0;
-    double beta = 0.0;
-    dsymv_(&UPLO, &k, &alpha, Q, &k, lambda, &inc, &beta, Qlam, &inc);
-
-    // tmp = Qlam + c 
-    double *tmp;
-    alloc_vector(tmp, k, double);
-    
-    double mintmp = BIG_NUMBER;
-
-    for (int i = 0; i < k; ++i) {
-        tmp[i] = Qlam[i] + c[i];
-        mintmp = (tmp[i] < mintmp) ? tmp[i] : mintmp;
-    }
-
-    /*
-     * if mintmp > 1
-     *      y = 0; z = tmp;
-     * else
-     *      y = mintmp - 1; z = tmp - y;
-     */
-    double y;
-    double dy;      // step for y
-    double *z;
-    alloc_vector(z, k, double);
-
-    if (mintmp > 1) {
-        y = 0.0;
-        dcopy_(&k, tmp, &inc, z, &inc);
-    }
-    else {
-        y = mintmp - 1.0;
         for (int i = 0; i < k; ++i)
-            z[i] = tmp[i] - y;
+            lambda[i] = 0.0;
+        lambda[best] = 1.0;
     }
 
-    // barrier parameter mu = (z' * lambda) / k
-    double mu = ddot_(&k, z, &inc, lambda, &inc) / k;
-    mu *= 0.5;
-
-    // adjoint Aty = y*e (e...vector of all ones)
-    double *Aty;
-    alloc_vector(Aty, k, double);
-
-    for (int i = 0; i < k; ++i)
-        Aty[i] = y;
-
-    // primal residual: 1 - e'*lambda
-    double res_p = 1.0 - ddot_(&k, &e, &inc_e, lambda, &inc); 
-
-    // initial dual cost: y - 1/2*lambda'*Qlam
-    temp = ddot_(&k, lambda, &inc, Qlam, &inc);         
-    double D_cost = y - 0.5 * temp;
-
-    // intial primal cost: lambda'*c + 1/2 *lambda'*Qlam   
-    double P_cost =  ddot_(&k, lambda, &inc, c, &inc) + 0.5 * temp;
-
-    // duality gap
-    double gap = P_cost - D_cost;    
-
-    // step lengths for primal and dual variables
-    double alpha_p, alpha_d;                    
-
-    /* allocate space for other variables */
-    int size = k + 1;
-    int size_square = size * size;
-
-    double *rhs, *dlambda, *dz;
-    alloc_vector(rhs, size, double);
-    alloc_vector(dlambda, k, double);
-    alloc_vector(dz, k, double);
-
-    // NOTE: M = [-Q-Diag(z./lambda) e; e' 0] --> only z and lambda change
-    // --> M_temp = [-Q e; e' 0]
-    double *M, *M_temp;
-    alloc_matrix(M, size, double);
-    alloc_matrix(M_temp, size, double);
-
-    /* constuct M_temp = [-Q e; e' 0] */
-    // NOTE: 0 is already there due to calloc in alloc_matrix!
-    for (int i = 0; i < size; ++i) {
-        for (int j = i; j < size; ++j) {
-
-            // matrix part
-            if ( (i < k) && (j < k) )
-                M_temp[j + i*size] = -Q[j + i*k];
-
-            // vector part
-            else if ( (i < k) && (j == k) ) 
-                M_temp[j + i*size] = 1.0;
+    /* free set of the starting point (keep the factorization if the set did not change) */
+    nf = 0;
+    for (int i = 0; i < k; ++i) {
+        if (lambda[i] > 0.0) {
+            if (nf >= ws->nfree || idx[nf] != i)
+                ws->factored = 0;
+            idx[nf++] = i;
         }
     }
+    if (nf != ws->nfree)
+        ws->factored = 0;
+    ws->nfree = nf;
 
-    // used in dsysv
-    int LWORK;
-    int *IPIV;
-    alloc_vector(IPIV, size, int); 
-    double WORK_TEMP;   // first call to dsysv returns optimal LWORK in WORK_TEMP
-    double *WORK;
+    for (int cnt = 0; cnt < 5 * k + 20; ++cnt) {
 
-    /*************
-     * main loop *
-     *************/
-    while( ABS(gap) > 1e-5 ) {
-
-        ++cnt;
+        /* grad = t*G'*G*lambda + c */
+        dcopy_(&k, c, &inc, grad, &inc);
+        dsymv_(&UPLO, &k, &t, GtG, &ld, lambda, &inc, &beta, grad, &inc);
 
-        /* built matrix M: remove Diag(z./lambda) from diagonal (1:k) of M_temp */
-        dcopy_(&size_square, M_temp, &inc, M, &inc);
-        for (int i = 0; i < k; ++i)
-            M[i + i*size] -= z[i]/lambda[i];
+        if (!ws->factored)
+            factor_free(ws, k, t);
 
         /* 
-         * right hand side (predictor):    
-         * rhs(1:k) = c - AT_y + Qlam
-         * rhs(k+1) = res_p
+         * step p on the free indices: min 1/2 p'Q_FF p + grad_F'p s.t. sum(p) = 0
+         * [Q_FF e; e' 0] [p; nu] = [-grad_F; 0]
          */
-        for (int i = 0; i < k; ++i)
-            rhs[i] = c[i] - Aty[i] + Qlam[i];
-
-        rhs[k] = res_p;
-
-        /* 
-         * solve linear system and extract solution
-         * dw = M\rhs;  
-         * dlam = dw(1:k);
-         * dy = dw(k+1);
-         */
-        //NOTE: dw is stored in rhs!
-
-        // to get optimal LWORK you need to run dsysv twice!
-        LWORK = -1;
-        dsysv_(&UPLO, &size, &inc, M, &size, IPIV, rhs, &size, &WORK_TEMP, &LWORK, &INFO);
-
-        // allocate space for WORK
-        LWORK = (int)WORK_TEMP;
-        alloc_vector(WORK, LWORK, double);
-
-        dsysv_(&UPLO, &size, &inc, M, &size, IPIV, rhs, &size, WORK, &LWORK, &INFO);
-
-        if (INFO != 0) {
-            fprintf(stderr, "%s: Problem in solving linear system \
-                (line: %d).\n", __func__, __LINE__);
-            exit(1);
+        int size = nf + 1;
+        for (int a = 0; a < nf; ++a)
+            p[a] = -grad[idx[a]];
+        p[nf] = 0.0;
+        dsytrs_(&UPLO, &size, &inc, ws->K, &size, ws->ipiv, p, &size, &INFO);
+
+        /* largest step in [0,1] that keeps lambda >= 0 */
+        double step = 1.0;
+        int leave = -1;
+        for (int a = 0; a < nf; ++a) {
+            if (p[a] < 0.0 && -lambda[idx[a]] / p[a] < step) {
+                step = -lambda[idx[a]] / p[a];
+                leave = a;
+            }
         }
 
-        free(WORK);
-
-        /* dlambda = rhs(1:k) and dy = rhs(k+1) */
-        dy = rhs[k];
-        dcopy_(&k, rhs, &inc, dlambda, &inc);
-
-        /* corrector for dz 
-         * dz = 1./lambda .* (mu*e-lambda.*z - z.*dlambda)
-         */
-        for (int i = 0; i < k; ++i)
-            dz[i] = 1.0/lambda[i] * (mu - lambda[i]*z[i] - z[i]*dlambda[i]);
-
-
-        /* find step lengths alpha_p and alpha_d s.t.
-         * lambda + alpha_p * dlambda >= 0 and
-         * z + alpha_d * dz >= 0 */
-
-        // alpha_p = max(-dlambda./lam)
-        // alpha_d = max(-dz./z)
-        alpha_p = -BIG_NUMBER;
-        alpha_d = -BIG_NUMBER;
+        for (int a = 0; a < nf; ++a)
+            lambda[idx[a]] += step * p[a];
+
+        if (leave < 0) {
+            /*
+             * lambda is optimal on the free set: grad_F = -nu*e and the multipliers
+             * of lambda_i >= 0 are grad_i + nu (release the most negative one)
+             */
+            dcopy_(&k, c, &inc, grad, &inc);
+            dsymv_(&UPLO, &k, &t, GtG, &ld, lambda, &inc, &beta, grad, &inc);
+
+            double nu = 0.0;
+            double scale = 0.0;
+            for (int a = 0; a < nf; ++a)
+                nu -= grad[idx[a]] / nf;
+            for (int i = 0; i < k; ++i)
+                scale = (ABS(grad[i]) > scale) ? ABS(grad[i]) : scale;
+
+            int enter = -1;
+            double mu_min = -1e-9 * (1.0 + scale);
+            for (int i = 0; i < k; ++i) {
+                if (lambda[i] == 0.0 && grad[i] + nu < mu_min) {
+                    mu_min = grad[i] + nu;
+                    enter = i;
+                }
+            }
 
-        for (int i = 0; i < k; ++i) {
-            temp = -dlambda[i]/lambda[i];
-            alpha_p = (temp > alpha_p) ? temp : alpha_p;
+            if (enter < 0)
+                break;
 
-            temp = -dz[i]/z[i];
-            alpha_d = (temp > alpha_d) ? temp : alpha_d;
+            /* release index enter (idx stays sorted) */
+            int a = nf;
+            while (a > 0 && idx[a-1] > enter) {
+                idx[a] = idx[a-1];
+                --a;
+            }
+            idx[a] = enter;
+            ws->nfree = ++nf;
+            ws->factored = 0;
+            continue;
         }
 
-        if (alpha_p > 0)
-            alpha_p = (0.99/alpha_p < 1.0) ? 0.99/alpha_p : 1.0;
-        else
-            alpha_p = 1.0;
-
-        if (alpha_d > 0)
-            alpha_d = (0.99/alpha_d < 1.0) ? 0.99/alpha_d : 1.0;
-        else
-            alpha_d = 1.0;
-
-        /**** update ****/
-        /* lambda = lambda + alpha_p * dlambda
-                y = y + alpha_d * dy
-                z = z + alpha_d * dz
-         */     
-        y += alpha_d * dy;
-        daxpy_(&k, &alpha_p, dlambda, &inc, lambda, &inc);
-        daxpy_(&k, &alpha_d, dz, &inc, z, &inc);
-
-        // adjoint
-        for (int i = 0; i < k; ++i)
-            Aty[i] = y;
-
-        // primal residual
-        res_p = 1 - ddot_(&k, lambda, &inc, &e, &inc_e);
+        lambda[idx[leave]] = 0.0;
 
-        // Qlam = Q*lambda
-        alpha = 1.0;
-        beta = 0.0;
-        dsymv_(&UPLO, &k, &alpha, Q, &k, lambda, &inc, &beta, Qlam, &inc);
-
-        /* mu = (z' * lambda) / k 
-         * mu = .4*mu
-         */
-        mu = ddot_(&k, lambda, &inc, z, &inc) / k;
-        mu *= 0.4;
-
-        if (alpha_p + alpha_d > 1.8)
-            mu *= 0.2; 
-
-
-        // dual cost: y - 1/2*lambda'*Qlam
-        temp = ddot_(&k, lambda, &inc, Qlam, &inc);         
-        D_cost = y - 0.5 * temp;
-
-        // primal cost: lam'*c + 1/2 *lam'*Qlam   
-        P_cost =  ddot_(&k, lambda, &inc, c, &inc) + 0.5 * temp;
-
-        // duality gap
-        gap = P_cost - D_cost; 
-
-        if (cnt > 30)
-            break; 
+        /* fix the indices that reached 0 */
+        int nf_old = nf;
+        nf = 0;
+        for (int a = 0; a < nf_old; ++a) {
+            if (lambda[idx[a]] > 0.0)
+                idx[nf++] = idx[a];
+            else
+                lambda[idx[a]] = 0.0;
+        }
+        ws->nfree = nf;
+        ws->factored = 0;
     } 
-
-    free(Qlam);
-    free(tmp);
-    free(z);
-    free(Aty);
-    free(rhs);
-    free(dlambda);
-    free(dz);
-    free(M);
-    free(M_temp);
-    free(IPIV);
-
 }
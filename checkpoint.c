@@ -0,0 +1,409 @@
+/* Checkpoint and resume of a running B&B solve */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "biqbin.h"
+
+/*
+ * Checkpoint file (binary, written to <name>.tmp and renamed):
+ *
+ *   magic, BabPbSize, words, BabLB, root_bound, diff, elapsed time, number of evaluated nodes,
+ *   state of the random number generator, BabSol->X, number of open nodes, node records
+ *
+ * Open nodes are the nodes in the heaps, the spilled nodes and the nodes that are currently
+ * processed by the workers (their children may not be in the queue yet). They are stored in
+ * the compact records of spill.c and streamed to the file: first the spill file, then one
+ * heap at a time under its own lock, then the nodes in process. While the records are
+ * streamed, workers also log every node that they insert or spill, so a node that moves
+ * to a part that was already written is not lost. A node may therefore be stored twice,
+ * which only costs its evaluation after a resume.
+ */
+
+#define CHECKPOINT_CHUNK 256    // node records of a heap written at once
+
+#define CHECKPOINT_MAGIC "BIQBCKP1"
+
+
+/*
+ * Random number generator of a solve (random_r on a state in the BabTree), so concurrent
+ * solves do not share a generator and a checkpoint saves the state of its own solve.
+ * The workers of a solve share the generator under tree->rng_lock. Two state buffers are
+ * used, since setstate_r stores the position in the current state before it reads the new one.
+ */
+void seedRandom(BiqBinContext *ctx, unsigned int seed) {
+
+    BabTree *tree = ctx->tree;
+
+    memset(&tree->rng, 0, sizeof(tree->rng));
+    tree->rng_current = 0;
+    initstate_r(seed, tree->rng_state[0], RNG_STATE_SIZE, &tree->rng);
+    pthread_mutex_init(&tree->rng_lock, NULL);
+}
+
+void freeRandom(BiqBinContext *ctx) {
+    pthread_mutex_destroy(&ctx->tree->rng_lock);
+}
+
+long Bab_random(const BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+    int32_t r;
+
+    pthread_mutex_lock(&tree->rng_lock);
+    random_r(&tree->rng, &r);
+    pthread_mutex_unlock(&tree->rng_lock);
+
+    return r;
+}
+
+void saveRandom(const BiqBinContext *ctx, char *state) {
+
+    BabTree *tree = ctx->tree;
+
+    pthread_mutex_lock(&tree->rng_lock);
+    // setstate_r stores the position of the generator in the current state
+    setstate_r(tree->rng_state[tree->rng_current], &tree->rng);
+    memcpy(state, tree->rng_state[tree->rng_current], RNG_STATE_SIZE);
+    pthread_mutex_unlock(&tree->rng_lock);
+}
+
+void restoreRandom(const BiqBinContext *ctx, const char *state) {
+
+    BabTree *tree = ctx->tree;
+
+    pthread_mutex_lock(&tree->rng_lock);
+    tree->rng_current = 1 - tree->rng_current;
+    memcpy(tree->rng_state[tree->rng_current], state, RNG_STATE_SIZE);
+    setstate_r(tree->rng_state[tree->rng_current], &tree->rng);
+    pthread_mutex_unlock(&tree->rng_lock);
+}
+
+
+/* checkpoints are written every params.checkpoint_interval seconds to <name>.checkpoint */
+void Checkpoint_Init(BiqBinContext *ctx, const char *name) {
+
+    BabTree *tree = ctx->tree;
+
+    if (tree->params.checkpoint_interval <= 0)
+        return;
+
+    Checkpoint *cp;
+    alloc(cp, Checkpoint);
+
+    snprintf(cp->path, sizeof(cp->path), "%s.checkpoint", name);
+    cp->interval = tree->params.checkpoint_interval;
+    cp->last = time_wall_clock();
+    cp->recordSize = nodeRecordSize(BAB_WORDS(tree->BabPbSize));
+    alloc_vector(cp->current, tree->numWorkers * cp->recordSize, char);
+    alloc_vector(cp->busy, tree->numWorkers, int);
+    cp->fd = -1;
+    pthread_mutex_init(&cp->lock, NULL);
+
+    tree->checkpoint = cp;
+}
+
+
+/* remove_file: the solve finished, so the last checkpoint is no longer needed */
+void Checkpoint_Free(BiqBinContext *ctx, int remove_file) {
+
+    Checkpoint *cp = ctx->tree->checkpoint;
+
+    if (cp == NULL)
+        return;
+
+    if (remove_file && cp->written > 0)
+        remove(cp->path);
+
+    pthread_mutex_destroy(&cp->lock);
+    free(cp->current);
+    free(cp->busy);
+    free(cp);
+
+    ctx->tree->checkpoint = NULL;
+}
+
+
+/*
+ * Record the node that the worker processes (NULL when done). Called while the node
+ * is still in the heap or its parent is still recorded, so a checkpoint never misses it.
+ */
+void Checkpoint_SetCurrent(const BiqBinContext *ctx, const BabNode *node) {
+
+    Checkpoint *cp = ctx->tree->checkpoint;
+
+    if (cp == NULL)
+        return;
+
+    pthread_mutex_lock(&cp->lock);
+    if (node != NULL)
+        packNode(cp->current + ctx->worker * cp->recordSize, node);
+    cp->busy[ctx->worker] = (node != NULL);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+
+/* write a checkpoint if the interval has passed (only one worker writes at a time) */
+void Checkpoint_Check(BiqBinContext *ctx) {
+
+    Checkpoint *cp = ctx->tree->checkpoint;
+    int idle = 0;
+
+    if (cp == NULL || ctx->tree->stopped || time_wall_clock() - cp->last < cp->interval)
+        return;
+
+    if (!atomic_compare_exchange_strong(&cp->writing, &idle, 1))
+        return;
+
+    Checkpoint_Write(ctx);
+    cp->last = time_wall_clock();
+
+    atomic_store(&cp->writing, 0);
+}
+
+
+/* append count node records to the checkpoint file; cp must be locked */
+static void write_records(Checkpoint *cp, const char *records, size_t count) {
+
+    size_t len = count * cp->recordSize;
+
+    while (len > 0 && !cp->failed) {
+        ssize_t written = write(cp->fd, records, len);
+        if (written < 0) {
+            if (errno != EINTR)
+                cp->failed = 1;
+            continue;
+        }
+        records += written;
+        len -= written;
+    }
+
+    cp->numRecords += count;
+}
+
+
+/* node inserted into a heap (heap is locked): stored if a checkpoint is written */
+void Checkpoint_LogNode(const BiqBinContext *ctx, const BabNode *node) {
+
+    Checkpoint *cp = ctx->tree->checkpoint;
+
+    if (cp == NULL || !atomic_load(&cp->active))
+        return;
+
+    char rec[cp->recordSize];
+    packNode(rec, node);
+
+    pthread_mutex_lock(&cp->lock);
+    if (cp->fd >= 0)
+        write_records(cp, rec, 1);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+
+/* node records written to the spill file (store is locked): stored if a checkpoint is written */
+void Checkpoint_LogRecords(const BiqBinContext *ctx, const char *records, int count) {
+
+    Checkpoint *cp = ctx->tree->checkpoint;
+
+    if (cp == NULL || !atomic_load(&cp->active))
+        return;
+
+    pthread_mutex_lock(&cp->lock);
+    if (cp->fd >= 0)
+        write_records(cp, records, count);
+    pthread_mutex_unlock(&cp->lock);
+}
+
+
+void Checkpoint_Write(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+    Checkpoint *cp = tree->checkpoint;
+    SpillStore *store = tree->spill;
+    size_t rs = cp->recordSize;
+    int n = tree->BabPbSize;
+    int words = BAB_WORDS(n);
+    double lb, elapsed;
+    int num_nodes;
+    uint64_t num_records;
+    char *header, *chunk;
+    size_t count;
+
+    /* header: magic, sizes, lb, root_bound, diff, elapsed, nodes, random state, X, records */
+    size_t header_size = 8 + 2 * sizeof(int) + 4 * sizeof(double) + sizeof(int) +
+                         RNG_STATE_SIZE + n * sizeof(int) + sizeof(uint64_t);
+
+    header = (char *) calloc(header_size, 1);
+    chunk = (char *) malloc(CHECKPOINT_CHUNK * rs);
+
+    /* write to temporary file and rename it, so the checkpoint is replaced atomically */
+    char tmp_path[sizeof(cp->path) + 4];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", cp->path);
+
+    int fd = (header != NULL && chunk != NULL) ? open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644) : -1;
+
+    if (fd < 0) {
+        fprintf(stderr, "Warning: Cannot write checkpoint %s.\n", cp->path);
+        free(header);
+        free(chunk);
+        return;
+    }
+
+    /* the header is filled in at the end, when the lower bound and the counters are known */
+    pthread_mutex_lock(&cp->lock);
+    cp->fd = fd;
+    cp->failed = 0;
+    cp->numRecords = 0;
+    cp->failed = (write(fd, header, header_size) != (ssize_t) header_size);
+    pthread_mutex_unlock(&cp->lock);
+
+    atomic_store(&cp->active, 1);
+
+    /* spill file: segments are copied from the mapping straight to the checkpoint */
+    if (store != NULL) {
+        pthread_mutex_lock(&store->lock);
+        pthread_mutex_lock(&cp->lock);
+        for (int s = 0; s < store->numSegments; ++s)
+            write_records(cp, store->map + store->segments[s].offset, store->segments[s].count);
+        pthread_mutex_unlock(&cp->lock);
+        pthread_mutex_unlock(&store->lock);
+    }
+
+    /* heaps: one at a time, the other workers keep running */
+    for (int w = 0; w < tree->numWorkers; ++w) {
+        Heap *heap = tree->heaps[w];
+        count = 0;
+        pthread_mutex_lock(&heap->lock);
+        for (int k = heap->low; heap->used > 0 && k <= heap->top; ++k)
+            for (int i = 0; i < heap->buckets[k].used; ++i) {
+                packNode(chunk + rs * count++, heap->buckets[k].data[i]);
+                if (count == CHECKPOINT_CHUNK) {
+                    pthread_mutex_lock(&cp->lock);
+                    write_records(cp, chunk, count);
+                    pthread_mutex_unlock(&cp->lock);
+                    count = 0;
+                }
+            }
+        pthread_mutex_lock(&cp->lock);
+        write_records(cp, chunk, count);
+        pthread_mutex_unlock(&cp->lock);
+        pthread_mutex_unlock(&heap->lock);
+    }
+
+    /* nodes in process; their children were logged if they were inserted meanwhile */
+    pthread_mutex_lock(&cp->lock);
+    for (int w = 0; w < tree->numWorkers; ++w)
+        if (cp->busy[w])
+            write_records(cp, cp->current + w * rs, 1);
+    atomic_store(&cp->active, 0);
+    cp->fd = -1;
+    num_records = cp->numRecords;
+    int ok = !cp->failed;
+    pthread_mutex_unlock(&cp->lock);
+
+    /* read last: nodes were only pruned with lower bounds up to this one */
+    char *p = header;
+    pthread_mutex_lock(&tree->lb_lock);
+    lb = Bab_LBGet(ctx);
+    memcpy(p + 8 + 2 * sizeof(int) + 4 * sizeof(double) + sizeof(int) + RNG_STATE_SIZE,
+           tree->BabSol->X, n * sizeof(int));
+    pthread_mutex_unlock(&tree->lb_lock);
+
+    num_nodes = Bab_numEvalNodes(ctx);
+    elapsed = time_wall_clock() - tree->TIME;
+
+    memcpy(p, CHECKPOINT_MAGIC, 8);                 p += 8;
+    memcpy(p, &n, sizeof(int));                     p += sizeof(int);
+    memcpy(p, &words, sizeof(int));                 p += sizeof(int);
+    memcpy(p, &lb, sizeof(double));                 p += sizeof(double);
+    memcpy(p, &tree->root_bound, sizeof(double));   p += sizeof(double);
+    memcpy(p, &tree->diff, sizeof(double));         p += sizeof(double);
+    memcpy(p, &elapsed, sizeof(double));            p += sizeof(double);
+    memcpy(p, &num_nodes, sizeof(int));             p += sizeof(int);
+    saveRandom(ctx, p);                             p += RNG_STATE_SIZE + n * sizeof(int);
+    memcpy(p, &num_records, sizeof(uint64_t));
+
+    ok = ok && pwrite(fd, header, header_size, 0) == (ssize_t) header_size;
+    ok = (fsync(fd) == 0) && ok;
+    ok = (close(fd) == 0) && ok;
+
+    if (ok && rename(tmp_path, cp->path) == 0)
+        cp->written++;
+    else
+        fprintf(stderr, "Warning: Cannot write checkpoint %s.\n", cp->path);
+
+    free(header);
+    free(chunk);
+}
+
+
+/*
+ * Restore the state of the solve from checkpoint file path: lower bound and solution,
+ * root bound, diff, counters, elapsed time and random generator. Open nodes are inserted
+ * into the heap of the calling worker. The bounding workspace must be allocated.
+ */
+void Checkpoint_Read(BiqBinContext *ctx, const char *path) {
+
+    BabTree *tree = ctx->tree;
+    char magic[8];
+    int n, words, num_nodes;
+    double lb, elapsed;
+    char rng[RNG_STATE_SIZE];
+    uint64_t num_records;
+    int *x;
+
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open checkpoint %s.\n", path);
+        exit(1);
+    }
+
+    if (fread(magic, 1, 8, file) != 8 || memcmp(magic, CHECKPOINT_MAGIC, 8) != 0 ||
+        fread(&n, sizeof(int), 1, file) != 1 || fread(&words, sizeof(int), 1, file) != 1 ||
+        n != tree->BabPbSize || words != BAB_WORDS(n)) {
+        fprintf(stderr, "Error: %s is not a checkpoint of this instance.\n", path);
+        exit(1);
+    }
+
+    alloc_vector(x, n, int);
+
+    if (fread(&lb, sizeof(double), 1, file) != 1 ||
+        fread(&tree->root_bound, sizeof(double), 1, file) != 1 ||
+        fread(&tree->diff, sizeof(double), 1, file) != 1 ||
+        fread(&elapsed, sizeof(double), 1, file) != 1 ||
+        fread(&num_nodes, sizeof(int), 1, file) != 1 ||
+        fread(rng, 1, RNG_STATE_SIZE, file) != RNG_STATE_SIZE ||
+        fread(x, sizeof(int), n, file) != (size_t) n ||
+        fread(&num_records, sizeof(uint64_t), 1, file) != 1) {
+        fprintf(stderr, "Error: Checkpoint %s is corrupted.\n", path);
+        exit(1);
+    }
+
+    Bab_LBInit(ctx, lb, x);
+    atomic_store(&tree->numNodes, num_nodes);
+    tree->TIME = time_wall_clock() - elapsed;
+    restoreRandom(ctx, rng);
+
+    size_t rs = nodeRecordSize(words);
+    char rec[rs];
+
+    for (uint64_t i = 0; i < num_records; ++i) {
+        if (fread(rec, rs, 1, file) != 1) {
+            fprintf(stderr, "Error: Checkpoint %s is corrupted.\n", path);
+            exit(1);
+        }
+        BabNode *node = newNode(ctx, NULL);
+        unpackNode(rec, node);
+        Bab_PQInsert(ctx, node);
+    }
+
+    fclose(file);
+    free(x);
+
+    printf("Resumed from checkpoint %s: %llu open nodes, %d evaluated nodes\n\n",
+           path, (unsigned long long) num_records, num_nodes);
+    fprintf(tree->output, "Resumed from checkpoint %s: %llu open nodes, %d evaluated nodes\n\n",
+            path, (unsigned long long) num_records, num_nodes);
+}
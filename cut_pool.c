@@ -0,0 +1,355 @@
+/* Global pool of cutting planes shared by all workers */
+
+#include <string.h>
+
+#include "biqbin.h"
+
+/*
+ * Cuts that are active (dual multiplier >= 1e-5) at the end of a node are stored in the pool
+ * with the vertices of the original graph. After the first triangle separation of a node
+ * (and the purge of the cuts inherited from the parent), pool cuts on free vertices that are
+ * violated by X and not in the node yet are added to the node.
+ *
+ * Every cut records in how many nodes it was active and when it was active last. When the
+ * pool is full, cuts that were not active in the older half of the period covered by the
+ * pool are removed (aging). Cuts are kept in insertion order in an array, a hash table
+ * (linear probing) maps the family and the key of a cut (see cutKey, so permuted copies of
+ * a cut are one pool cut) to its position in the array.
+ */
+
+static const int num_vertices[3] = {3, 5, 7};
+
+
+static uint64_t cut_hash(int family, const int *key) {
+
+    uint64_t h = 1469598103934665603ULL;       // FNV-1a
+
+    h = (h ^ (uint64_t) family) * 1099511628211ULL;
+    for (int a = 0; a <= num_vertices[family]; ++a)
+        h = (h ^ (uint64_t) key[a]) * 1099511628211ULL;
+
+    return h;
+}
+
+
+/* slot of the cut in the hash table, or the empty slot where it would be inserted */
+static int find_slot(const CutPool *pool, int family, const int *key, uint64_t h) {
+
+    int mask = pool->slots - 1;
+    int s = (int) (h & mask);
+
+    while (pool->table[s] >= 0) {
+        const PoolCut *cut = &pool->cuts[pool->table[s]];
+        if (cut->hash == h && cut->family == family &&
+            memcmp(cut->key, key, (num_vertices[family] + 1) * sizeof(int)) == 0)
+            return s;
+        s = (s + 1) & mask;
+    }
+
+    return s;
+}
+
+
+/* rebuild the hash table from the array of cuts */
+static void rebuild_table(CutPool *pool) {
+
+    for (int s = 0; s < pool->slots; ++s)
+        pool->table[s] = -1;
+
+    for (int c = 0; c < pool->size; ++c) {
+        const PoolCut *cut = &pool->cuts[c];
+        pool->table[find_slot(pool, cut->family, cut->key, cut->hash)] = c;
+    }
+}
+
+
+/* remove cuts that were last active before the middle of the period covered by the pool */
+static void age_pool(CutPool *pool) {
+
+    int oldest = pool->cuts[0].last;
+    int newest = pool->cuts[0].last;
+
+    for (int c = 1; c < pool->size; ++c) {
+        if (pool->cuts[c].last < oldest)
+            oldest = pool->cuts[c].last;
+        if (pool->cuts[c].last > newest)
+            newest = pool->cuts[c].last;
+    }
+
+    int threshold = oldest + (newest - oldest + 1) / 2;
+    int next = 0;
+
+    for (int c = 0; c < pool->size; ++c)
+        if (pool->cuts[c].last >= threshold)
+            pool->cuts[next++] = pool->cuts[c];
+
+    pool->evicted += pool->size - next;
+    pool->size = next;
+
+    rebuild_table(pool);
+}
+
+
+void CutPool_Init(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+
+    if (tree->params.cut_pool <= 0)
+        return;
+
+    CutPool *pool;
+    alloc(pool, CutPool);
+
+    pool->cap = tree->params.cut_pool;
+    pool->slots = 1;
+    while (pool->slots < 2 * pool->cap)
+        pool->slots *= 2;
+
+    alloc_vector(pool->cuts, pool->cap, PoolCut);
+    alloc_vector(pool->table, pool->slots, int);
+    rebuild_table(pool);
+    pthread_mutex_init(&pool->lock, NULL);
+
+    tree->cut_pool = pool;
+}
+
+
+void CutPool_Free(BiqBinContext *ctx) {
+
+    CutPool *pool = ctx->tree->cut_pool;
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->cuts);
+    free(pool->table);
+    free(pool);
+
+    ctx->tree->cut_pool = NULL;
+}
+
+
+size_t CutPool_Memory(const BiqBinParameters *params) {
+
+    size_t slots = 1;
+
+    if (params->cut_pool <= 0)
+        return 0;
+
+    while (slots < 2 * (size_t) params->cut_pool)
+        slots *= 2;
+
+    return params->cut_pool * sizeof(PoolCut) + slots * sizeof(int);
+}
+
+
+/*
+ * Add pool cuts on free vertices of the current node that are violated by X (newest first,
+ * at most as many per family as one separation adds). Added cuts are new cuts with
+ * multiplier 0. The pool is only locked while the candidates are copied to ctx->pool_cuts.
+ * Returns the number of added cuts.
+ */
+int CutPool_Probe(BiqBinContext *ctx, const double *X) {
+
+    CutPool *pool = ctx->tree->cut_pool;
+    const BiqBinParameters *params = &ctx->tree->params;
+    Problem *PP = ctx->PP;
+    int BabPbSize = ctx->tree->BabPbSize;
+
+    if (pool == NULL)
+        return 0;
+
+    int row[BabPbSize + 1];             // row of PP of each vertex (-1 if the vertex is fixed)
+    int first[3] = {PP->NIneq, PP->NPentIneq, PP->NHeptaIneq};      // cuts of the node before the probe
+    int limit[3] = {PP->NIneq + params->TriIneq, PP->NPentIneq + 3 * params->Pent_Trials,
+                    PP->NHeptaIneq + 4 * params->Hepta_Trials};
+    int max[3] = {MaxTriIneqAdded, MaxPentIneqAdded, MaxHeptaIneqAdded};
+    int *count[3] = {&PP->NIneq, &PP->NPentIneq, &PP->NHeptaIneq};
+    size_t probed = 0;
+    int added = 0;
+
+    for (int f = 0; f < 3; ++f)
+        if (limit[f] > max[f])
+            limit[f] = max[f];
+    if (!params->include_Pent)
+        limit[1] = PP->NPentIneq;
+    if (!params->include_Hepta)
+        limit[2] = PP->NHeptaIneq;
+
+    for (int v = 0; v <= BabPbSize; ++v)
+        row[v] = -1;
+    for (int i = 0; i < PP->n; ++i)
+        row[ctx->PP_vars[i]] = i;
+
+    // hash sets of the cuts of the node, added cuts are inserted
+    for (int f = 0; f < 3; ++f)
+        CutHash_Build(ctx, f);
+
+    /* take the cuts on free vertices (newest first, vertices mapped to rows of PP), 
+     * so they are evaluated without holding the pool */
+    int num_cuts = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    for (int c = pool->size - 1; c >= 0; --c) {
+
+        const PoolCut *cut = &pool->cuts[c];
+        PoolCut *copy = &ctx->pool_cuts[num_cuts];
+        int w = num_vertices[cut->family];
+        int a;
+
+        // family without room (or not used)
+        if (first[cut->family] == limit[cut->family])
+            continue;
+
+        for (a = 0; a < w && row[cut->v[a]] >= 0; ++a)
+            copy->v[a] = row[cut->v[a]];
+        if (a < w)
+            continue;
+
+        copy->family = cut->family;
+        copy->type = cut->type;
+        ++num_cuts;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int c = 0; c < num_cuts; ++c) {
+
+        const PoolCut *cut = &ctx->pool_cuts[c];
+        const int *p = cut->v;
+        int f = cut->family;
+
+        if (*count[f] == limit[f])
+            continue;
+
+        ++probed;
+        double value = evaluateCut(X, PP->n, f, cut->type, p);
+        if (value <= params->violated_Ineq)
+            continue;
+
+        // skip cuts that the node already has (inherited, separated or permuted copies)
+        if (CutHash_Add(ctx, f, *count[f], cut->type, p))
+            continue;
+
+        int next_ineq = (*count[f])++;
+
+        if (f == 0) {
+            Triangle_Inequality *new_cut = &ctx->Cuts[next_ineq];
+            new_cut->type = cut->type;
+            new_cut->i = p[0];
+            new_cut->j = p[1];
+            new_cut->k = p[2];
+            new_cut->value = value;
+            new_cut->row = -1;
+            new_cut->y = 0.0;
+        }
+        else if (f == 1) {
+            Pentagonal_Inequality *new_cut = &ctx->Pent_Cuts[next_ineq];
+            new_cut->type = cut->type;
+            memcpy(new_cut->permutation, p, 5 * sizeof(int));
+            new_cut->value = value;
+            new_cut->row = -1;
+            new_cut->y = 0.0;
+        }
+        else {
+            Heptagonal_Inequality *new_cut = &ctx->Hepta_Cuts[next_ineq];
+            new_cut->type = cut->type;
+            memcpy(new_cut->permutation, p, 7 * sizeof(int));
+            new_cut->value = value;
+            new_cut->row = -1;
+            new_cut->y = 0.0;
+        }
+        ++added;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->probed += probed;
+    pool->hits += added;
+    pthread_mutex_unlock(&pool->lock);
+
+    return added;
+}
+
+
+/* store (or refresh) one cut; pool must be locked */
+static void store_cut(CutPool *pool, int family, int type, const int *v, int now) {
+
+    int key[CUT_KEY_SIZE];
+
+    cutKey(family, type, v, key);
+
+    uint64_t h = cut_hash(family, key);
+    int s = find_slot(pool, family, key, h);
+
+    if (pool->table[s] >= 0) {
+        PoolCut *cut = &pool->cuts[pool->table[s]];
+        ++cut->active;
+        cut->last = now;
+        return;
+    }
+
+    if (pool->size == pool->cap) {
+        age_pool(pool);
+        if (pool->size == pool->cap)
+            return;
+        s = find_slot(pool, family, key, h);
+    }
+
+    PoolCut *cut = &pool->cuts[pool->size];
+    cut->family = family;
+    cut->type = type;
+    memcpy(cut->v, v, num_vertices[family] * sizeof(int));
+    memcpy(cut->key, key, (num_vertices[family] + 1) * sizeof(int));
+    cut->active = 1;
+    cut->last = now;
+    cut->hash = h;
+
+    pool->table[s] = pool->size++;
+}
+
+
+/* store the cuts of the current node with multiplier y[i] >= 1e-5 (y is gamma) */
+void CutPool_Store(BiqBinContext *ctx, const double *y) {
+
+    CutPool *pool = ctx->tree->cut_pool;
+    const Problem *PP = ctx->PP;
+    const int *vars = ctx->PP_vars;
+    int now = Bab_numEvalNodes(ctx);
+    int yindex = 0;
+    int v[7];
+
+    if (pool == NULL)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+
+    for (int ineq = 0; ineq < PP->NIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        v[0] = vars[ctx->Cuts[ineq].i];
+        v[1] = vars[ctx->Cuts[ineq].j];
+        v[2] = vars[ctx->Cuts[ineq].k];
+        store_cut(pool, 0, ctx->Cuts[ineq].type, v, now);
+        ++pool->stored;
+    }
+
+    for (int ineq = 0; ineq < PP->NPentIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        for (int a = 0; a < 5; ++a)
+            v[a] = vars[ctx->Pent_Cuts[ineq].permutation[a]];
+        store_cut(pool, 1, ctx->Pent_Cuts[ineq].type, v, now);
+        ++pool->stored;
+    }
+
+    for (int ineq = 0; ineq < PP->NHeptaIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        for (int a = 0; a < 7; ++a)
+            v[a] = vars[ctx->Hepta_Cuts[ineq].permutation[a]];
+        store_cut(pool, 2, ctx->Hepta_Cuts[ineq].type, v, now);
+        ++pool->stored;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+}
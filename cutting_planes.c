@@ -1,18 +1,79 @@
 #include <math.h>
+#include <string.h>
 #include "biqbin.h"
 
-extern BiqBinParameters params;
+/************************* HASH SETS OF CUTS *************************/
 
-extern Triangle_Inequality *Cuts;        
-extern Triangle_Inequality *List; 
+/*
+ * Every family of cuts has a hash set of the keys of the current cuts of the node (ctx->cut_hash),
+ * so the update functions and CutPool_Probe find out in O(1) whether a cut is already included.
+ * The set is built from the cuts inherited from the parent before the pool is probed, rebuilt from
+ * the kept cuts after purging, and every added cut is inserted. The key of a cut (see cutKey) does
+ * not depend on the order of its vertices, so permuted copies of a cut are detected as well.
+ */
+
+static const int cut_width[3] = {3, 5, 7};
+
+
+/*
+ * Returns 1 if the set contains the cut of family with type and vertices p. Otherwise the cut
+ * is inserted as cut c (position in the vector of cuts).
+ */
+static int cuthash_add(CutHash *set, int c, int family, int type, const int *p) {
+
+    int *key = set->keys + (size_t) CUT_KEY_SIZE * c;
+    int len = cut_width[family] + 1;
+    int mask = set->slots - 1;
+    uint64_t h = 1469598103934665603ULL;       // FNV-1a
+
+    cutKey(family, type, p, key);
+
+    for (int a = 0; a < len; ++a)
+        h = (h ^ (uint64_t) key[a]) * 1099511628211ULL;
+
+    int s = (int) (h & mask);
+    while (set->table[s] >= 0) {
+        int d = set->table[s];
+        if (set->hash[d] == h && memcmp(set->keys + (size_t) CUT_KEY_SIZE * d, key, len * sizeof(int)) == 0)
+            return 1;
+        s = (s + 1) & mask;
+    }
+
+    set->table[s] = c;
+    set->hash[c] = h;
+
+    return 0;
+}
+
+
+/* build the hash set of the current cuts of family (0 triangle, 1 pentagonal, 2 heptagonal) */
+void CutHash_Build(BiqBinContext *ctx, int family) {
+
+    CutHash *set = ctx->cut_hash[family];
 
-extern Pentagonal_Inequality *Pent_Cuts;        
-extern Pentagonal_Inequality *Pent_List;
+    for (int s = 0; s < set->slots; ++s)
+        set->table[s] = -1;
 
-extern Heptagonal_Inequality *Hepta_Cuts;        
-extern Heptagonal_Inequality *Hepta_List;
+    if (family == 0) {
+        for (int ineq = 0; ineq < ctx->PP->NIneq; ++ineq)
+            cuthash_add(set, ineq, 0, ctx->Cuts[ineq].type, (int []) {ctx->Cuts[ineq].i, ctx->Cuts[ineq].j, ctx->Cuts[ineq].k});
+    }
+    else if (family == 1) {
+        for (int ineq = 0; ineq < ctx->PP->NPentIneq; ++ineq)
+            cuthash_add(set, ineq, 1, ctx->Pent_Cuts[ineq].type, ctx->Pent_Cuts[ineq].permutation);
+    }
+    else {
+        for (int ineq = 0; ineq < ctx->PP->NHeptaIneq; ++ineq)
+            cuthash_add(set, ineq, 2, ctx->Hepta_Cuts[ineq].type, ctx->Hepta_Cuts[ineq].permutation);
+    }
+}
+
+
+/* Returns 1 if the node has the cut, otherwise the cut is inserted as cut c of family */
+int CutHash_Add(BiqBinContext *ctx, int family, int c, int type, const int *p) {
+    return cuthash_add(ctx->cut_hash[family], c, family, type, p);
+}
 
-extern double *X;
 
 /************************* TRIANGLE INEQUALITIES *************************/
 
@@ -40,86 +101,235 @@ double evaluateTriangleInequality(double *XX, int N, int type, int ii, int jj, i
 
 
 /* 
- * Evaluates each triangle inequality (i.e. cut) using the X matrix and
- * fills the Triangle_Inequality array named List, with at most params.TriIneq
- * inequalities that are violated by at least params.violated_Ineq.
- * It also returns the value of the cut that is violated the most by X.
+ * Separation of triangle inequalities. For every triple ii > jj > kk the four types are
+ * evaluated together from X_ij, X_ik and X_jk; X is symmetric, so X_ik and X_jk are read from
+ * the contiguous columns ii and jj. Rows ii are processed in blocks of TRI_BLOCK, so the
+ * columns jj stay in cache for all rows of a block, and kk runs in chunks of TRI_CHUNK
+ * through a branch-free loop that the compiler vectorizes. A pair (ii, jj) is skipped when
+ * |X_ij| + rowmax[ii] + rowmax[jj] - 1 (rowmax = largest off-diagonal |X| in the row) proves
+ * that none of its cuts enters the list or raises the maximum violation.
+ *
+ * The most violated cuts are kept in a bounded min-heap ordered by violation (ties: the cut
+ * that comes first in the order type, ii, jj, kk wins), so the list does not depend on the
+ * order of evaluation. With params.sep_threads > 1 blocks of rows are distributed over
+ * threads with their own heaps that are merged at the end. The list is returned in the
+ * order type, ii, jj, kk.
  */
-double getViolated_TriangleInequalities(double *X, int N, Triangle_Inequality *List, int *ListSize) {
 
-    int ListCount;                              // loop index
-    int size = 0;                               // number of added cuts
-    int LeastViolatedIneq = 0;                  // index of least violated inequality
-    double LeastViolatedIneqValue = BIG_NUMBER; // minimum violation
-    double maxAllIneq = -BIG_NUMBER;            // maximum violation
-    double test_ineqvalue;                      // violation of current cut
+#define TRI_BLOCK 32
+#define TRI_CHUNK 64
+
+/* state of one separation thread */
+typedef struct TriSeparation {
+    const double *X;
+    const double *rowmax;
+    int N;
+    int K;                          // maximum size of the heap (params.TriIneq)
+    double violated;                // params.violated_Ineq
+    int first, step;                // blocks first, first + step, ...
+    Triangle_Inequality *heap;
+    int size;
+    double maxAllIneq;
+} TriSeparation;
+
+
+/* cut a is less violated than cut b */
+static inline int tri_less(const Triangle_Inequality *a, const Triangle_Inequality *b) {
+
+    if (a->value != b->value)
+        return a->value < b->value;
+    if (a->type != b->type)
+        return a->type > b->type;
+    if (a->i != b->i)
+        return a->i > b->i;
+    if (a->j != b->j)
+        return a->j > b->j;
+    return a->k > b->k;
+}
 
-    // Loop through all inequalities
-    for (int type = 1; type <= 4; ++type) {
 
-        for (int ii = 0; ii < N; ++ii) {
-            for (int jj = 0; jj < ii; ++jj) {
-                for (int kk = 0; kk < jj; ++kk) {
+/* order of the list: type, ii, jj, kk */
+static int tri_compare_order(const void *p, const void *q) {
 
-                    test_ineqvalue = evaluateTriangleInequality(X, N, type, ii, jj, kk);
+    const Triangle_Inequality *a = (const Triangle_Inequality *) p;
+    const Triangle_Inequality *b = (const Triangle_Inequality *) q;
 
-                    // keep track of the maximum value of test_ineqvalue, i.e. 
-                    // current most violated cut value
-                    maxAllIneq = (test_ineqvalue > maxAllIneq) ? test_ineqvalue : maxAllIneq;
+    if (a->type != b->type)
+        return a->type - b->type;
+    if (a->i != b->i)
+        return a->i - b->i;
+    if (a->j != b->j)
+        return a->j - b->j;
+    return a->k - b->k;
+}
 
-                    if (test_ineqvalue > params.violated_Ineq) {
 
-                        // (1) put first params.TriIneq violated inequalities in list and 
-                        //     keep track of the least violated inequality
-                        if (size < params.TriIneq) {
+/* restore the heap property below position pos (heap[0] is the least violated cut) */
+static void tri_sift_down(Triangle_Inequality *heap, int size, int pos) {
 
-                            // add ineq to the end of List
-                            List[size].type  = type;
-                            List[size].i     = ii;
-                            List[size].j     = jj;
-                            List[size].k     = kk;
-                            List[size].value = test_ineqvalue;
+    Triangle_Inequality cut = heap[pos];
 
-                            // update LeastViolatedIneq
-                            if (size == 0 || test_ineqvalue < LeastViolatedIneqValue) {
-                                LeastViolatedIneqValue = test_ineqvalue;
-                                LeastViolatedIneq = size;
-                            }
+    for (int child = 2 * pos + 1; child < size; child = 2 * pos + 1) {
+        if (child + 1 < size && tri_less(&heap[child + 1], &heap[child]))
+            ++child;
+        if (!tri_less(&heap[child], &cut))
+            break;
+        heap[pos] = heap[child];
+        pos = child;
+    }
+    heap[pos] = cut;
+}
 
-                            ++size;
-                        } 
-                        else if (test_ineqvalue > LeastViolatedIneqValue) 
-                        {
-                            // (2) if you find an inequality that is violated more than the 
-                            //     least violated inequality, then add it to the list, 
-                            //     remove the least violated inequality, and find 
-                            //     the new least violated inequality in the list
-
-                            // add ineq to the list, replacing LeastViolatedIneq
-                            List[LeastViolatedIneq].type  = type;
-                            List[LeastViolatedIneq].i     = ii;
-                            List[LeastViolatedIneq].j     = jj;
-                            List[LeastViolatedIneq].k     = kk;
-                            List[LeastViolatedIneq].value = test_ineqvalue;
-
-                            // update LeastViolatedIneq
-                            LeastViolatedIneqValue = BIG_NUMBER;
-                            for (ListCount = 0; ListCount < size; ++ListCount) 
-                            {
-                                // if ineq is less violated
-                                if (List[ListCount].value < LeastViolatedIneqValue) 
-                                {
-                                    LeastViolatedIneqValue = List[ListCount].value;
-                                    LeastViolatedIneq = ListCount;
-                                }
+
+/* add cut to the heap if it is full, the least violated cut is replaced if cut is violated more */
+static void tri_push(Triangle_Inequality *heap, int *size, int K, const Triangle_Inequality *cut) {
+
+    if (*size < K) {
+        int pos = (*size)++;
+        while (pos > 0 && tri_less(cut, &heap[(pos - 1) / 2])) {
+            heap[pos] = heap[(pos - 1) / 2];
+            pos = (pos - 1) / 2;
+        }
+        heap[pos] = *cut;
+    }
+    else if (K > 0 && tri_less(&heap[0], cut)) {
+        heap[0] = *cut;
+        tri_sift_down(heap, K, 0);
+    }
+}
+
+
+static void *tri_separate(void *arg) {
+
+    TriSeparation *sep = (TriSeparation *) arg;
+    const double *X = sep->X;
+    int N = sep->N;
+    double values[TRI_CHUNK];
+
+    for (int i0 = sep->first * TRI_BLOCK; i0 < N; i0 += sep->step * TRI_BLOCK) {
+
+        int i1 = (i0 + TRI_BLOCK < N) ? i0 + TRI_BLOCK : N;
+
+        for (int jj = 0; jj < i1 - 1; ++jj) {
+
+            const double *Xj = X + (size_t) jj * N;
+
+            for (int ii = (jj + 1 > i0) ? jj + 1 : i0; ii < i1; ++ii) {
+
+                const double *Xi = X + (size_t) ii * N;
+                double c = Xi[jj];
+
+                // cuts violated less change neither the list nor the maximum violation
+                // (a cut with equal violation may still win the tie in tri_push)
+                double threshold = sep->violated;
+                if (sep->size == sep->K && sep->K > 0 && sep->heap[0].value > threshold)
+                    threshold = sep->heap[0].value;
+                if (sep->maxAllIneq < threshold)
+                    threshold = sep->maxAllIneq;
+
+                if (fabs(c) + sep->rowmax[ii] + sep->rowmax[jj] - 1.0 + 1e-12 < threshold)
+                    continue;
+
+                for (int k0 = 0; k0 < jj; k0 += TRI_CHUNK) {
+
+                    int len = (jj - k0 < TRI_CHUNK) ? jj - k0 : TRI_CHUNK;
+                    const double *a = Xi + k0;
+                    const double *b = Xj + k0;
+
+                    // largest violation of the four types
+                    for (int kk = 0; kk < len; ++kk) {
+                        double t1 = -c - a[kk] - b[kk] - 1.0;
+                        double t2 = -c + a[kk] + b[kk] - 1.0;
+                        double t3 =  c - a[kk] + b[kk] - 1.0;
+                        double t4 =  c + a[kk] - b[kk] - 1.0;
+                        double t12 = (t1 > t2) ? t1 : t2;
+                        double t34 = (t3 > t4) ? t3 : t4;
+                        values[kk] = (t12 > t34) ? t12 : t34;
+                    }
+
+                    for (int kk = 0; kk < len; ++kk) {
+
+                        if (values[kk] < threshold)
+                            continue;
+
+                        if (values[kk] > sep->maxAllIneq)
+                            sep->maxAllIneq = values[kk];
+
+                        double t[4] = { -c - a[kk] - b[kk] - 1.0, -c + a[kk] + b[kk] - 1.0,
+                                         c - a[kk] + b[kk] - 1.0,  c + a[kk] - b[kk] - 1.0 };
+
+                        for (int type = 1; type <= 4; ++type) {
+                            if (t[type - 1] > sep->violated) {
+                                Triangle_Inequality cut = { .i = ii, .j = jj, .k = k0 + kk,
+                                                            .type = type, .value = t[type - 1] };
+                                tri_push(sep->heap, &sep->size, sep->K, &cut);
                             }
                         }
                     }
-                } // kk loop
-            } // jj loop
-        } // ii loop
+                }
+            }
+        }
+    }
 
-    } // type loop
+    return NULL;
+}
+
+
+/*
+ * Evaluates each triangle inequality (i.e. cut) using the X matrix and
+ * fills the Triangle_Inequality array named List, with at most params.TriIneq
+ * inequalities that are violated by at least params.violated_Ineq.
+ * It also returns the value of the cut that is violated the most by X.
+ */
+double getViolated_TriangleInequalities(const BiqBinContext *ctx, double *X, int N, Triangle_Inequality *List, int *ListSize) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
+    double *rowmax = ctx->tri_rowmax;
+    int blocks = (N + TRI_BLOCK - 1) / TRI_BLOCK;
+    int threads = (params->sep_threads < blocks) ? params->sep_threads : blocks;
+
+    if (threads < 1)
+        threads = 1;
+
+    for (int ii = 0; ii < N; ++ii) {
+        rowmax[ii] = 0.0;
+        for (int kk = 0; kk < N; ++kk)
+            if (kk != ii && fabs(X[kk + ii * N]) > rowmax[ii])
+                rowmax[ii] = fabs(X[kk + ii * N]);
+    }
+
+    TriSeparation sep[threads];
+    pthread_t tid[threads];
+    int created[threads];
+
+    for (int t = 0; t < threads; ++t)
+        sep[t] = (TriSeparation) { .X = X, .rowmax = rowmax, .N = N, .K = params->TriIneq,
+                                   .violated = params->violated_Ineq, .first = t, .step = threads,
+                                   .heap = (t == 0) ? List : ctx->tri_heaps + (size_t) (t - 1) * params->TriIneq,
+                                   .size = 0, .maxAllIneq = -BIG_NUMBER };
+
+    // thread 0 is the calling worker
+    for (int t = 1; t < threads; ++t) {
+        created[t] = (pthread_create(&tid[t], NULL, tri_separate, &sep[t]) == 0);
+        if (!created[t])
+            tri_separate(&sep[t]);
+    }
+    tri_separate(&sep[0]);
+
+    double maxAllIneq = sep[0].maxAllIneq;
+    int size = sep[0].size;
+
+    for (int t = 1; t < threads; ++t) {
+        if (created[t])
+            pthread_join(tid[t], NULL);
+        for (int c = 0; c < sep[t].size; ++c)
+            tri_push(List, &size, params->TriIneq, &sep[t].heap[c]);
+        if (sep[t].maxAllIneq > maxAllIneq)
+            maxAllIneq = sep[t].maxAllIneq;
+    }
+
+    // list in the order of type, ii, jj, kk
+    qsort(List, size, sizeof(Triangle_Inequality), tri_compare_order);
 
     *ListSize = size;
 
@@ -129,7 +339,11 @@ double getViolated_TriangleInequalities(double *X, int N, Triangle_Inequality *L
 
 /* update inequalities: purge old ones and separate new ones */
 /* returns the new maximum violation of triangle inequalities */
-double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted) {
+double updateTriangleInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted) {
+
+    Problem *PP = ctx->PP;
+    Triangle_Inequality *Cuts = ctx->Cuts;
+    Triangle_Inequality *List = ctx->List;
 
     int ineq;                   // index for inequality        
     int yindex;                 // index for dual multipliers          
@@ -157,6 +371,7 @@ double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *Nu
             Cuts[next_ineq].i     = Cuts[ineq].i;
             Cuts[next_ineq].j     = Cuts[ineq].j;
             Cuts[next_ineq].k     = Cuts[ineq].k;
+            Cuts[next_ineq].row   = Cuts[ineq].row;
             Cuts[next_ineq].y     = Cuts[ineq].y;
 
             ++next_ineq;
@@ -165,9 +380,12 @@ double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *Nu
 
     PP->NIneq -= subtracted;
 
+    // hash set of the kept cuts
+    CutHash_Build(ctx, 0);
+
 
     // separate new triangle inequalities
-    double maxAllIneq = getViolated_TriangleInequalities(X, N, List, &ListSize);
+    double maxAllIneq = getViolated_TriangleInequalities(ctx, ctx->X, N, List, &ListSize);
 
     // Add List to Cuts
     int added = 0;
@@ -177,18 +395,9 @@ double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *Nu
         if (next_ineq == MaxTriIneqAdded)
             break;
 
-        // Check if inequality is already included in Cuts
-        int found_ineq = 0;
-        for (ineq = 0; ineq < PP->NIneq; ++ineq) {
-
-            if (Cuts[ineq].type == List[ListCount].type &&
-                    Cuts[ineq].i == List[ListCount].i &&
-                    Cuts[ineq].j == List[ListCount].j &&
-                    Cuts[ineq].k == List[ListCount].k) 
-            {
-                found_ineq = 1;
-            }
-        }
+        // Check if inequality is already included in Cuts (otherwise it is inserted into the set)
+        int found_ineq = CutHash_Add(ctx, 0, next_ineq, List[ListCount].type,
+                                     (int []) {List[ListCount].i, List[ListCount].j, List[ListCount].k});
 
         // If inequality not already in Cuts, add it to Cuts
         if (!found_ineq) {
@@ -198,6 +407,7 @@ double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *Nu
             Cuts[next_ineq].j     = List[ListCount].j;
             Cuts[next_ineq].k     = List[ListCount].k;
             Cuts[next_ineq].value = List[ListCount].value;
+            Cuts[next_ineq].row   = -1;
             Cuts[next_ineq].y     = 0.0;     // set dual multipliers of new triangle ineq to 0
 
             ++next_ineq;
@@ -221,7 +431,9 @@ double updateTriangleInequalities(Problem *PP, double *y, int *NumAdded, int *Nu
  * QAP and fills the Pentagonal_Inequality array named Pent_List, with at most 3 * params.Pent_Trials
  * inequalities. It also returns the value of the inequlity that is violated the most by X.
  */
-double getViolated_PentagonalInequalities(double *X, int N, Pentagonal_Inequality *Pent_List, int *ListSize) {
+double getViolated_PentagonalInequalities(const BiqBinContext *ctx, double *X, int N, Pentagonal_Inequality *Pent_List, int *ListSize) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
 
     int ListCount;                                  // loop index
     int size = 0;                                   // number of added cuts
@@ -232,7 +444,7 @@ double getViolated_PentagonalInequalities(double *X, int N, Pentagonal_Inequalit
 
 
     // 5 tuple of indeces defining the violated pentagonal inequality
-    static int pent[5];
+    int pent[5];
 
     /* 5x5 matrices that define pentagonal inequalities are stored as rows in H */
 
@@ -244,20 +456,20 @@ double getViolated_PentagonalInequalities(double *X, int N, Pentagonal_Inequalit
                             {1, 1, -1, -1, -1, 1, 1, -1, -1, -1, -1, -1, 1, 1, 1, -1, -1, 1, 1, 1, -1, -1, 1, 1, 1} };      // H3
 
 
-    for (int num_trial = 0; num_trial < params.Pent_Trials; ++num_trial) {
+    for (int num_trial = 0; num_trial < params->Pent_Trials; ++num_trial) {
         for (int type = 1; type <= 3; ++type) {
 
-            test_ineqvalue = qap_simulated_annealing(&H[type-1][0], 5, X, N, pent);
+            test_ineqvalue = qap_simulated_annealing(ctx, &H[type-1][0], 5, X, N, pent);
 
             // keep track of the minimum value of test_ineqvalue, i.e. 
             // current most violated cut value
             minAllIneq = (test_ineqvalue < minAllIneq) ? test_ineqvalue : minAllIneq;
 
-            if (test_ineqvalue < 1.0 - params.violated_Ineq) {
+            if (test_ineqvalue < 1.0 - params->violated_Ineq) {
 
                 // (1) put first 3 * params.Pent_Trials violated inequalities in list and 
                 //     keep track of the least violated inequality
-                if (size < 3 * params.Pent_Trials) {
+                if (size < 3 * params->Pent_Trials) {
 
                     // add ineq to the end of Pent_List
                     Pent_List[size].type  = type;
@@ -313,7 +525,11 @@ double getViolated_PentagonalInequalities(double *X, int N, Pentagonal_Inequalit
 /* update inequalities: purge old ones and separate new ones */
 /* returns the new maximum violation of pentagonal inequalities */
 
-double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted, int triag) {
+double updatePentagonalInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted, int triag) {
+
+    Problem *PP = ctx->PP;
+    Pentagonal_Inequality *Pent_Cuts = ctx->Pent_Cuts;
+    Pentagonal_Inequality *Pent_List = ctx->Pent_List;
 
     int ineq;                   // index for inequality        
     int yindex;                 // index for dual multipliers          
@@ -338,6 +554,7 @@ double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
         else // keep inequality
         {
             Pent_Cuts[next_ineq].type  = Pent_Cuts[ineq].type;
+            Pent_Cuts[next_ineq].row   = Pent_Cuts[ineq].row;
             Pent_Cuts[next_ineq].y     = Pent_Cuts[ineq].y;
 
             for (int i = 0; i < 5; ++i)
@@ -349,9 +566,12 @@ double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
 
     PP->NPentIneq -= subtracted;
 
+    // hash set of the kept cuts
+    CutHash_Build(ctx, 1);
+
 
     // separate new pentagonal inequalities
-    double maxAllIneq = getViolated_PentagonalInequalities(X, N, Pent_List, &ListSize);
+    double maxAllIneq = getViolated_PentagonalInequalities(ctx, ctx->X, N, Pent_List, &ListSize);
 
     // Add List to Cuts
     int added = 0;
@@ -361,20 +581,8 @@ double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
         if (next_ineq == MaxPentIneqAdded)
             break;
 
-        // Check if inequality is already included in Pent_Cuts
-        int found_ineq = 0;
-        for (ineq = 0; ineq < PP->NPentIneq; ++ineq) {
-
-            if (Pent_Cuts[ineq].type == Pent_List[ListCount].type &&
-                Pent_Cuts[ineq].permutation[0] == Pent_List[ListCount].permutation[0] &&
-                Pent_Cuts[ineq].permutation[1] == Pent_List[ListCount].permutation[1] &&
-                Pent_Cuts[ineq].permutation[2] == Pent_List[ListCount].permutation[2] &&
-                Pent_Cuts[ineq].permutation[3] == Pent_List[ListCount].permutation[3] &&
-                Pent_Cuts[ineq].permutation[4] == Pent_List[ListCount].permutation[4])
-            {
-                found_ineq = 1;
-            }
-        }
+        // Check if inequality is already included in Pent_Cuts (otherwise it is inserted into the set)
+        int found_ineq = CutHash_Add(ctx, 1, next_ineq, Pent_List[ListCount].type, Pent_List[ListCount].permutation);
 
         // If inequality not already in Pent_Cuts, add it to Pent_Cuts
         if (!found_ineq) {
@@ -387,6 +595,7 @@ double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
             Pent_Cuts[next_ineq].permutation[4] = Pent_List[ListCount].permutation[4];
 
             Pent_Cuts[next_ineq].value          = Pent_List[ListCount].value;
+            Pent_Cuts[next_ineq].row            = -1;
 
             // set dual multipliers of new pentagonal ineq to 0
             Pent_Cuts[next_ineq].y              = 0.0;     
@@ -413,7 +622,9 @@ double updatePentagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
  * QAP and fills the Heptagonal_Inequality array named Hepta_List, with at most 4 * params.Hepta_Trials
  * inequalities. It also returns the value of the inequlity that is violated the most by X.
  */
-double getViolated_HeptagonalInequalities(double *X, int N, Heptagonal_Inequality *Hepta_List, int *ListSize) {
+double getViolated_HeptagonalInequalities(const BiqBinContext *ctx, double *X, int N, Heptagonal_Inequality *Hepta_List, int *ListSize) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
 
     int ListCount;                                  // loop index
     int size = 0;                                   // number of added cuts
@@ -424,7 +635,7 @@ double getViolated_HeptagonalInequalities(double *X, int N, Heptagonal_Inequalit
 
 
     // 7 tuple of indeces defining the violated heptagonal inequality
-    static int hept[7];
+    int hept[7];
 
     /* 7x7 matrices that define heptagonal inequalities are stored as rows in H */
 
@@ -438,20 +649,20 @@ double getViolated_HeptagonalInequalities(double *X, int N, Heptagonal_Inequalit
                             {1, 1, 1, -1, -1, -1, -1, 1, 1, 1, -1, -1, -1, -1, 1, 1, 1, -1, -1, -1, -1, -1, -1, -1, 1, 1, 1, 1, -1, -1, -1, 1, 1, 1, 1, -1, -1, -1, 1, 1, 1, 1, -1, -1, -1, 1, 1, 1, 1} };    // H4
 
 
-    for (int num_trial = 0; num_trial < params.Hepta_Trials; ++num_trial) {
+    for (int num_trial = 0; num_trial < params->Hepta_Trials; ++num_trial) {
         for (int type = 1; type <= 4; ++type) {
 
-            test_ineqvalue = qap_simulated_annealing(&H[type-1][0], 7, X, N, hept);
+            test_ineqvalue = qap_simulated_annealing(ctx, &H[type-1][0], 7, X, N, hept);
 
             // keep track of the minimum value of test_ineqvalue, i.e. 
             // current most violated cut value
             minAllIneq = (test_ineqvalue < minAllIneq) ? test_ineqvalue : minAllIneq;
 
-            if (test_ineqvalue < 1.0 - params.violated_Ineq) {
+            if (test_ineqvalue < 1.0 - params->violated_Ineq) {
 
                 // (1) put first 4 * params.Hepta_Trials violated inequalities in list and 
                 //     keep track of the least violated inequality
-                if (size < 4 * params.Hepta_Trials) {
+                if (size < 4 * params->Hepta_Trials) {
 
                     // add ineq to the end of Pent_List
                     Hepta_List[size].type  = type;
@@ -506,7 +717,11 @@ double getViolated_HeptagonalInequalities(double *X, int N, Heptagonal_Inequalit
 /* update inequalities: purge old ones and separate new ones */
 /* returns the new maximum violation of heptagonal inequalities */
 
-double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *NumSubtracted, int hept_index) {
+double updateHeptagonalInequalities(BiqBinContext *ctx, double *y, int *NumAdded, int *NumSubtracted, int hept_index) {
+
+    Problem *PP = ctx->PP;
+    Heptagonal_Inequality *Hepta_Cuts = ctx->Hepta_Cuts;
+    Heptagonal_Inequality *Hepta_List = ctx->Hepta_List;
 
     int ineq;                   // index for inequality        
     int yindex;                 // index for dual multipliers          
@@ -531,6 +746,7 @@ double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
         else // keep inequality
         {
             Hepta_Cuts[next_ineq].type  = Hepta_Cuts[ineq].type;
+            Hepta_Cuts[next_ineq].row   = Hepta_Cuts[ineq].row;
             Hepta_Cuts[next_ineq].y     = Hepta_Cuts[ineq].y;
 
             for (int i = 0; i < 7; ++i)
@@ -542,8 +758,11 @@ double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
 
     PP->NHeptaIneq -= subtracted;
 
+    // hash set of the kept cuts
+    CutHash_Build(ctx, 2);
+
     // separate new heptagonal inequalities
-    double maxAllIneq = getViolated_HeptagonalInequalities(X, N, Hepta_List, &ListSize);
+    double maxAllIneq = getViolated_HeptagonalInequalities(ctx, ctx->X, N, Hepta_List, &ListSize);
 
     // Add List to Cuts
     int added = 0;
@@ -553,22 +772,8 @@ double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
         if (next_ineq == MaxHeptaIneqAdded)
             break;
 
-        // Check if inequality is already included in Hepta_Cuts
-        int found_ineq = 0;
-        for (ineq = 0; ineq < PP->NHeptaIneq; ++ineq) {
-
-            if (Hepta_Cuts[ineq].type == Hepta_List[ListCount].type &&
-                Hepta_Cuts[ineq].permutation[0] == Hepta_List[ListCount].permutation[0] &&
-                Hepta_Cuts[ineq].permutation[1] == Hepta_List[ListCount].permutation[1] &&
-                Hepta_Cuts[ineq].permutation[2] == Hepta_List[ListCount].permutation[2] &&
-                Hepta_Cuts[ineq].permutation[3] == Hepta_List[ListCount].permutation[3] &&
-                Hepta_Cuts[ineq].permutation[4] == Hepta_List[ListCount].permutation[4] &&
-                Hepta_Cuts[ineq].permutation[5] == Hepta_List[ListCount].permutation[5] &&
-                Hepta_Cuts[ineq].permutation[6] == Hepta_List[ListCount].permutation[6])
-            {
-                found_ineq = 1;
-            }
-        }
+        // Check if inequality is already included in Hepta_Cuts (otherwise it is inserted into the set)
+        int found_ineq = CutHash_Add(ctx, 2, next_ineq, Hepta_List[ListCount].type, Hepta_List[ListCount].permutation);
 
         // If inequality not already in Hepta_Cuts, add it to Hepta_Cuts
         if (!found_ineq) {
@@ -583,6 +788,7 @@ double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
             Hepta_Cuts[next_ineq].permutation[6] = Hepta_List[ListCount].permutation[6];
 
             Hepta_Cuts[next_ineq].value          = Hepta_List[ListCount].value;
+            Hepta_Cuts[next_ineq].row            = -1;
 
             // set dual multipliers of new heptagonal ineq to 0
             Hepta_Cuts[next_ineq].y              = 0.0;     
@@ -600,3 +806,147 @@ double updateHeptagonalInequalities(Problem *PP, double *y, int *NumAdded, int *
     return maxAllIneq;
 
 }
+
+
+/************************* CUTS OF THE PARENT NODE *************************/
+
+/*
+ * Store the cuts of the current node with multiplier y[i] >= 1e-5 (y is gamma, cuts in
+ * the order triangle, pentagonal, heptagonal) in ctx->cuts_cur, with vertices of the
+ * original graph. Cuts with a smaller multiplier would be purged in the next separation.
+ */
+void storeCuts(BiqBinContext *ctx, const double *y) {
+
+    const Problem *PP = ctx->PP;
+    const int *vars = ctx->PP_vars;
+    CutSet *set = ctx->cuts_cur;
+    int yindex = 0;
+    int count;
+
+    count = 0;
+    for (int ineq = 0; ineq < PP->NIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        set->Cuts[count]   = ctx->Cuts[ineq];
+        set->Cuts[count].i = vars[ctx->Cuts[ineq].i];
+        set->Cuts[count].j = vars[ctx->Cuts[ineq].j];
+        set->Cuts[count].k = vars[ctx->Cuts[ineq].k];
+        set->Cuts[count].y = y[yindex];
+        ++count;
+    }
+    set->NIneq = count;
+
+    count = 0;
+    for (int ineq = 0; ineq < PP->NPentIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        set->Pent_Cuts[count] = ctx->Pent_Cuts[ineq];
+        for (int p = 0; p < 5; ++p)
+            set->Pent_Cuts[count].permutation[p] = vars[ctx->Pent_Cuts[ineq].permutation[p]];
+        set->Pent_Cuts[count].y = y[yindex];
+        ++count;
+    }
+    set->NPentIneq = count;
+
+    count = 0;
+    for (int ineq = 0; ineq < PP->NHeptaIneq; ++ineq, ++yindex) {
+        if (y[yindex] < 1e-5)
+            continue;
+        set->Hepta_Cuts[count] = ctx->Hepta_Cuts[ineq];
+        for (int p = 0; p < 7; ++p)
+            set->Hepta_Cuts[count].permutation[p] = vars[ctx->Hepta_Cuts[ineq].permutation[p]];
+        set->Hepta_Cuts[count].y = y[yindex];
+        ++count;
+    }
+    set->NHeptaIneq = count;
+}
+
+
+/*
+ * Start the current node with the cuts of the node being branched (ctx->parent) whose vertices
+ * are all rows of PP, i.e. drop the cuts on the branching variable. The multipliers
+ * of the parent are written to y (and kept in the cuts). Returns the number of cuts.
+ */
+int loadParentCuts(BiqBinContext *ctx, double *y) {
+
+    if (ctx->parent == NULL)
+        return 0;
+
+    Problem *PP = ctx->PP;
+    const CutSet *set = &ctx->parent->cuts;
+    int BabPbSize = ctx->tree->BabPbSize;
+    int row[BabPbSize + 1];             // row of PP of each vertex (-1 if the vertex is fixed)
+    int next_ineq, p;
+
+    for (int v = 0; v <= BabPbSize; ++v)
+        row[v] = -1;
+    for (int i = 0; i < PP->n; ++i)
+        row[ctx->PP_vars[i]] = i;
+
+    /* triangle inequalities */
+    next_ineq = 0;
+    for (int ineq = 0; ineq < set->NIneq; ++ineq) {
+
+        const Triangle_Inequality *cut = &set->Cuts[ineq];
+
+        if (row[cut->i] < 0 || row[cut->j] < 0 || row[cut->k] < 0)
+            continue;
+
+        ctx->Cuts[next_ineq]     = *cut;
+        ctx->Cuts[next_ineq].i   = row[cut->i];
+        ctx->Cuts[next_ineq].j   = row[cut->j];
+        ctx->Cuts[next_ineq].k   = row[cut->k];
+        ctx->Cuts[next_ineq].row = -1;
+        ++next_ineq;
+    }
+    PP->NIneq = next_ineq;
+
+    /* pentagonal inequalities */
+    next_ineq = 0;
+    for (int ineq = 0; ineq < set->NPentIneq; ++ineq) {
+
+        const Pentagonal_Inequality *cut = &set->Pent_Cuts[ineq];
+
+        for (p = 0; p < 5 && row[cut->permutation[p]] >= 0; ++p)
+            ;
+        if (p < 5)
+            continue;
+
+        ctx->Pent_Cuts[next_ineq] = *cut;
+        for (p = 0; p < 5; ++p)
+            ctx->Pent_Cuts[next_ineq].permutation[p] = row[cut->permutation[p]];
+        ctx->Pent_Cuts[next_ineq].row = -1;
+        ++next_ineq;
+    }
+    PP->NPentIneq = next_ineq;
+
+    /* heptagonal inequalities */
+    next_ineq = 0;
+    for (int ineq = 0; ineq < set->NHeptaIneq; ++ineq) {
+
+        const Heptagonal_Inequality *cut = &set->Hepta_Cuts[ineq];
+
+        for (p = 0; p < 7 && row[cut->permutation[p]] >= 0; ++p)
+            ;
+        if (p < 7)
+            continue;
+
+        ctx->Hepta_Cuts[next_ineq] = *cut;
+        for (p = 0; p < 7; ++p)
+            ctx->Hepta_Cuts[next_ineq].permutation[p] = row[cut->permutation[p]];
+        ctx->Hepta_Cuts[next_ineq].row = -1;
+        ++next_ineq;
+    }
+    PP->NHeptaIneq = next_ineq;
+
+    /* multipliers: gamma in the order triangle, pentagonal, heptagonal */
+    for (int i = 0; i < PP->NIneq; ++i)
+        y[i] = ctx->Cuts[i].y;
+    for (int i = 0; i < PP->NPentIneq; ++i)
+        y[PP->NIneq + i] = ctx->Pent_Cuts[i].y;
+    for (int i = 0; i < PP->NHeptaIneq; ++i)
+        y[PP->NIneq + PP->NPentIneq + i] = ctx->Hepta_Cuts[i].y;
+
+    return PP->NIneq + PP->NPentIneq + PP->NHeptaIneq;
+}
+
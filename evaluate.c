@@ -1,47 +1,52 @@
-#include "biqbin.h"
+#include <string.h>
 
-extern BiqBinParameters params;
-extern FILE *output;
-extern int BabPbSize;      
+#include "biqbin.h"
 
 /*
  * Evaluate a specific node.
  * This function computes the upper and lower bounds of a specific node
  * (calls SDP bound function) and returns the upper bound of the node
  */
-double Evaluate(BabNode *node, Problem *SP, Problem *PP) {
+double Evaluate(BiqBinContext *ctx, BabNode *node) {
+
+    const BiqBinParameters *params = &ctx->tree->params;
+    FILE *output = ctx->tree->output;
+    int BabPbSize = ctx->tree->BabPbSize;
 
     // Write node count, problem size, and fixed variables to output file
-    if (params.detailedOutput) {
+    if (params->detailedOutput) {
         fprintf(output, "\n");
         fprintf(output, 
                 "**************************************************************************************************************************\n");
         fprintf(output, 
-                "                                               Node %d\n", Bab_numEvalNodes());
+                "                                               Node %d\n", Bab_numEvalNodes(ctx));
         fprintf(output, 
                 "**************************************************************************************************************************\n");
         fprintf(output, "Problem size %d\n", BabPbSize + 1 - countFixedVariables(node));
         
         fprintf(output, "Fixed variables:");
         for (int i = 0; i < BabPbSize; ++i) {
-            if (node->xfixed[i]) {
-                fprintf(output, " (x[%d],%d)", i, node->sol.X[i]);
+            if (Bab_isFixed(node, i)) {
+                fprintf(output, " (x[%d],%d)", i, Bab_solValue(node, i));
             }
         }
         fprintf(output, "\n");
     }    
 
     // create subproblem PP
-    createSubproblem(node, SP, PP);
+    createSubproblem(ctx, node, ctx->tree->SP, ctx->PP);
+
+    // the first solve of the basic SDP relaxation starts from the final point of the parent
+    ctx->ipm_cur->n = 0;
 
     // compute the SDP upper bound and run heuristic
-    double bound = SDPbound(node, SP, PP);
+    double bound = SDPbound(ctx, node);
 
     // Save node information to the output file
 
-    if (params.detailedOutput) {
+    if (params->detailedOutput) {
         fprintf(output, "Depth = %d, Bound = %.2lf, Best = %.0lf\n", 
-                node->level, bound, Bab_LBGet());
+                node->level, bound, Bab_LBGet(ctx));
         fprintf(output, "\n");
     }    
 
@@ -50,6 +55,37 @@ double Evaluate(BabNode *node, Problem *SP, Problem *PP) {
 
 
 
+/*
+ * Collects indices of variables of node into idx (in increasing order) by scanning the bitsets 
+ * word by word: free variables if fixed_to_one == 0, otherwise variables fixed to 1.
+ * Returns the number of collected indices.
+ */
+static int collectVariables(const BabNode *node, int BabPbSize, int fixed_to_one, int *idx) {
+
+    int count = 0;
+    uint64_t word;
+
+    for (int w = 0; w < node->words; ++w) {
+
+        if (fixed_to_one)
+            word = node->bits[w] & node->bits[node->words + w];
+        else
+            word = ~node->bits[w];
+
+        // clear bits past BabPbSize in the last word
+        if (64 * (w + 1) > BabPbSize)
+            word &= (~(uint64_t) 0) >> (64 * (w + 1) - BabPbSize);
+
+        while (word) {
+            idx[count++] = 64 * w + __builtin_ctzll(word);
+            word &= word - 1;
+        }
+    }
+
+    return count;
+}
+
+
 /*
  * Writes subproblem to PP.
  *
@@ -64,7 +100,9 @@ double Evaluate(BabNode *node, Problem *SP, Problem *PP) {
  * 
  * max x'LX, s.t. x in {-1,1}^(PP->n)
  */
-void createSubproblem(BabNode *node, Problem *SP, Problem *PP) {
+void createSubproblem(const BiqBinContext *ctx, BabNode *node, Problem *SP, Problem *PP) {
+
+    int BabPbSize = ctx->tree->BabPbSize;
 
     // Subproblem size is the number of non-fixed variables in the node
     PP->n = BabPbSize + 1 - countFixedVariables(node);
@@ -83,40 +121,45 @@ void createSubproblem(BabNode *node, Problem *SP, Problem *PP) {
     int N = SP->n;
     double row_sum = 0.0;
     
+    // free variables and variables fixed to 1 (from the bitsets of the node)
+    int free_vars[PP->n - 1];
+    int one_vars[BabPbSize];
+    int num_free = collectVariables(node, BabPbSize, 0, free_vars);
+    int num_ones = collectVariables(node, BabPbSize, 1, one_vars);
+    
+    // rows of PP->L: free variables and the last vertex (fixed to 0)
+    memcpy(ctx->PP_vars, free_vars, num_free * sizeof(int));
+    ctx->PP_vars[PP->n - 1] = BabPbSize;
+    
     // rows which are deleted due to fixed variable
     // later add to diagonal
     double fixedRow[PP->n - 1];
     for (int i = 0; i < PP->n - 1; ++i)
         fixedRow[i] = 0.0;
 
-    // counter for fixedRow
-    int fixed = 0;      
-       
     // last element (lower right corner) is sum
     double sum = 0.0;   
 
-
-    for (int i = 0; i < BabPbSize; ++i) {
-        for (int j = 0; j < BabPbSize; ++j) {
-            if (!node->xfixed[i] && !node->xfixed[j]) {     // delete rows and cols of SP->L
-                PP->L[index] = SP->L[j + i*N];
-                row_sum += PP->L[index];
-                ++index;               
-            }
-            else if ( (node->xfixed[i] && node->sol.X[i] == 1) && !node->xfixed[j]) { // save fixed rows to add to diagonal
-                fixedRow[fixed] += SP->L[j + i*N];
-                ++fixed;
-            }
-        }
-
-        if (!node->xfixed[i]) {
-            PP->L[index] = row_sum;       // vector part of PP->L (last column)
+    // delete rows and cols of fixed variables from SP->L
+    for (int a = 0; a < num_free; ++a) {
+        for (int b = 0; b < num_free; ++b) {
+            PP->L[index] = SP->L[free_vars[b] + free_vars[a]*N];
+            row_sum += PP->L[index];
             ++index;
         }    
 
+        PP->L[index] = row_sum;       // vector part of PP->L (last column)
+        ++index;
+
         // row scaned, set to 0
         row_sum = 0.0;
-        fixed = 0;
+    }
+
+    // save rows of variables fixed to 1 to add to diagonal
+    for (int a = 0; a < num_ones; ++a) {
+        for (int b = 0; b < num_free; ++b) {
+            fixedRow[b] += SP->L[free_vars[b] + one_vars[a]*N];
+        }
     }
 
     // add last row (copy from last column)
@@ -149,16 +192,19 @@ void createSubproblem(BabNode *node, Problem *SP, Problem *PP) {
  * The fixed value is contribution of the fixed variables to 
  * the objective value.
  */
-double getFixedValue(BabNode *node, Problem *SP) {
+double getFixedValue(const BiqBinContext *ctx, BabNode *node, Problem *SP) {
 
+    int BabPbSize = ctx->tree->BabPbSize;
     int N = SP->n;
     double fixedvalue = 0.0;
 
-    for (int i = 0; i < BabPbSize; ++i) {
-        for (int j = 0; j < BabPbSize; ++j) {
-            if (node->xfixed[i] && node->xfixed[j]) {
-                fixedvalue += SP->L[j + i*N] * node->sol.X[i] * node->sol.X[j];
-            }
+    // only variables fixed to 1 contribute
+    int one_vars[BabPbSize];
+    int num_ones = collectVariables(node, BabPbSize, 1, one_vars);
+
+    for (int a = 0; a < num_ones; ++a) {
+        for (int b = 0; b < num_ones; ++b) {
+            fixedvalue += SP->L[one_vars[b] + one_vars[a]*N];
         }
     }
 
@@ -1,20 +1,20 @@
 /* Max-Heap data structure implementation in C */
 /* Used for priority queue for B&B algorithm */
 
-#include "biqbin.h"
+#include <string.h>
+#include <math.h>
 
-/* definitions of global variables for priority queue */
-int BabPbSize;                      // number of nodes in original graph - 1 (last variable fixed to 0)
-BabSolution *BabSol;                // global solution of B&B algorithm
-static double BabLB;                // global lower bound (use double since int may overflow!)
-static int Bab_numNodes = 0;        // number of B&B nodes
-BabNode *BabRoot;                   // root node
-Heap *heap = NULL;                  // heap is allocated as array of BabNode*
+#include "biqbin.h"
 
+/* 
+ * Priority queue, global lower bound and solution of the B&B algorithm are stored in the 
+ * BabTree of the solve (ctx->tree). Every worker owns one heap (array of BabNode*). 
+ * Workers pop from their own heap and steal from the other heaps when their own heap is empty.
+ */
 
-double Bab_LBGet(void) { return BabLB; }
-int Bab_numEvalNodes(void) { return Bab_numNodes; }
-void Bab_incEvalNodes(void) { ++Bab_numNodes; }
+double Bab_LBGet(const BiqBinContext *ctx) { return atomic_load(&ctx->tree->BabLB); }
+int Bab_numEvalNodes(const BiqBinContext *ctx) { return atomic_load(&ctx->tree->numNodes); }
+void Bab_incEvalNodes(BiqBinContext *ctx) { atomic_fetch_add(&ctx->tree->numNodes, 1); }
 
 
 /* Function that determines priority of the BaBNode-s.
@@ -30,9 +30,9 @@ inline int compare_Nodes(const BabNode* node1, const BabNode* node2) {
 }
 
 
-inline void swap_entries(int i, int j) {
+static inline void swap_entries(Bucket *bucket, int i, int j) {
 
-    BabNode** data = heap->data;
+    BabNode** data = bucket->data;
     BabNode* t;
 
     t       = data[i];
@@ -41,41 +41,41 @@ inline void swap_entries(int i, int j) {
 }
 
 /* heapify down from root */
-static void heapify_down(int current) {
+static void heapify_down(Bucket *bucket, int current) {
 
-    BabNode** data = heap->data;  
+    BabNode** data = bucket->data;  
     int child = 2 * current + 1;  // left child
 
     /* 
      * place element in root in correct position to maintain heap
      */
-    if (child + 1 < heap->used) {// right child check
+    if (child + 1 < bucket->used) {// right child check
       if (compare_Nodes(data[child + 1], data[child]) > 0)
          child++;
     }
      
-    while(child < heap->used && compare_Nodes(data[current], data[child]) < 0)
+    while(child < bucket->used && compare_Nodes(data[current], data[child]) < 0)
     {
-        swap_entries(current, child);
+        swap_entries(bucket, current, child);
 
         current = child;
         child   = 2 * current + 1;
       
-        if (child + 1 < heap->used)
+        if (child + 1 < bucket->used)
             if (compare_Nodes(data[child + 1], data[child]) > 0)
                 child++;
     }
 }
 
 /* heapify up from last node*/
-static void heapify_up(int current) {
+static void heapify_up(Bucket *bucket, int current) {
 
-    BabNode** data = heap->data;
+    BabNode** data = bucket->data;
     int parent = (current-1) / 2;
 
     while(current > 0 && compare_Nodes(data[parent], data[current]) < 0)
     {
-        swap_entries(current, parent);
+        swap_entries(bucket, current, parent);
         current = parent;
         parent  = (current-1) / 2;
     }
@@ -83,53 +83,568 @@ static void heapify_up(int current) {
 
 
 // initializes heap for storing B&B subproblems via BabNode*
-Heap* Init_Heap(int size) {
+Heap* Init_Heap(void) {
 
     Heap *heap;
     alloc(heap, Heap);
 
-    heap->size = size;
     heap->used = 0;
-    alloc_vector(heap->data, heap->size, BabNode*);
+    heap->numBuckets = 0;
+    heap->low = 0;
+    heap->top = -1;
+    heap->buckets = NULL;
+    pthread_mutex_init(&heap->lock, NULL);
 
     return heap;
 }
 
 
-int isPQEmpty(void) {
-   return heap->used == 0;
+/* 
+ * Set up buckets on first insert: buckets cover upper bounds from the current 
+ * lower bound (nodes below cannot be inserted) up to the bound of the first node.
+ */
+static void init_buckets(Heap *heap, double lowerBound, double upperBound) {
+
+    heap->origin = floor(lowerBound);
+    heap->width = 1.0;
+    while ((upperBound - heap->origin) / heap->width >= PQ_MAX_BUCKETS)
+        heap->width *= 2.0;
+
+    heap->numBuckets = (int) ((upperBound - heap->origin) / heap->width) + 1;
+    alloc_vector(heap->buckets, heap->numBuckets, Bucket);
+}
+
+
+/* index of the bucket for upper bound; adds buckets if the bound is above the last bucket */
+static int bucket_index(Heap *heap, double upperBound) {
+
+    int k = (int) floor((upperBound - heap->origin) / heap->width);
+
+    if (k < heap->low)
+        k = heap->low;
+
+    if (k >= heap->numBuckets) {
+        int num = (k + 1 > 2 * heap->numBuckets) ? k + 1 : 2 * heap->numBuckets;
+
+        heap->buckets = (Bucket *) realloc(heap->buckets, num * sizeof(Bucket));
+        if (heap->buckets == NULL) {
+            fprintf(stderr, "Error: Not enough memory for priority queue.\n");
+            exit(1);
+        }
+        for (int i = heap->numBuckets; i < num; ++i)
+            heap->buckets[i] = (Bucket) { 0, 0, NULL };
+        heap->numBuckets = num;
+    }
+
+    return k;
+}
+
+
+static void free_heap(Heap *heap) {
+
+    for (int k = 0; k < heap->numBuckets; ++k)
+        free(heap->buckets[k].data);
+    free(heap->buckets);
+    pthread_mutex_destroy(&heap->lock);
+    free(heap);
+}
+
+
+// allocates one heap and one node pool per worker
+void Init_PQ_Workers(BiqBinContext *ctx, int num_workers) {
+
+    BabTree *tree = ctx->tree;
+
+    tree->numWorkers = num_workers;
+    alloc_vector(tree->heaps, num_workers, Heap*);
+    alloc_vector(tree->pools, num_workers, NodePool);
+
+    for (int w = 0; w < num_workers; ++w)
+        tree->heaps[w] = Init_Heap();
+
+    tree->liveNodes = 0;
+    tree->peakNodes = 0;
+    tree->warmMemory = 0;
+
+    Spill_Init(ctx);
+
+    tree->pending = 0;
+    tree->epoch = 0;
+    tree->idleWorkers = 0;
+    pthread_mutex_init(&tree->idle_lock, NULL);
+    pthread_cond_init(&tree->idle_cond, NULL);
+    pthread_mutex_init(&tree->lb_lock, NULL);
+}
+
+
+void Free_PQ_Workers(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+
+    for (int w = 0; w < tree->numWorkers; ++w)
+        free_heap(tree->heaps[w]);
+    free(tree->heaps);
+    tree->heaps = NULL;
+
+    for (int w = 0; w < tree->numWorkers; ++w) {
+        PoolSlab *slab = tree->pools[w].slabs;
+        while (slab != NULL) {
+            PoolSlab *next = slab->next;
+            free(slab);
+            slab = next;
+        }
+    }
+    free(tree->pools);
+    tree->pools = NULL;
+
+    Spill_Free(ctx);
+    tree->numWorkers = 0;
+
+    pthread_mutex_destroy(&tree->idle_lock);
+    pthread_cond_destroy(&tree->idle_cond);
+    pthread_mutex_destroy(&tree->lb_lock);
 }
 
 
-BabNode* Bab_PQPop(void) {
+int isPQEmpty(BiqBinContext *ctx) {
+
+    Heap **heaps = ctx->tree->heaps;
+    int empty = 1;
+
+    for (int w = 0; w < ctx->tree->numWorkers && empty; ++w) {
+        pthread_mutex_lock(&heaps[w]->lock);
+        empty = (heaps[w]->used == 0);
+        pthread_mutex_unlock(&heaps[w]->lock);
+    }
+
+    return empty && Spill_TopBound(ctx) == -BIG_NUMBER;
+}
+
+
+/* node with the highest priority; heap must be locked and non-empty */
+static inline BabNode* heap_top(const Heap *heap) {
+    return heap->buckets[heap->top].data[0];
+}
+
+
+/* take root of the highest non-empty bucket; heap must be locked and non-empty */
+static BabNode* heap_pop(Heap *heap) {
+
+   Bucket *bucket = &heap->buckets[heap->top];
 
    /* safe root, swap it with last node and heapify */     
-   BabNode *node = heap->data[0];
+   BabNode *node = bucket->data[0];
 
-   heap->data[0] = NULL;
-   heap->used--;
+   bucket->data[0] = NULL;
+   bucket->used--;
 
-   swap_entries(0, heap->used);
+   swap_entries(bucket, 0, bucket->used);
    
-   heapify_down(0);
+   heapify_down(bucket, 0);
+
+   heap->used--;
+
+   // move top to the next non-empty bucket
+   while (heap->top >= heap->low && heap->buckets[heap->top].used == 0)
+       heap->top--;
+   if (heap->top < heap->low)
+       heap->top = -1;
       
    return node;
 }
 
 
-void Bab_PQInsert(BabNode *node) {
-   
-    // check heap size
-    if (heap->size == heap->used) {
-        puts("\nERROR: Maximum size of heap reached.\n");
-        exit(1);
+/* free all nodes in buckets with upper bounds <= lowerBound + 1; heap must be locked */
+static int heap_prune(const BiqBinContext *ctx, Heap *heap, double lowerBound) {
+
+    int pruned = 0;
+
+    while (heap->low < heap->numBuckets && 
+           heap->origin + (heap->low + 1) * heap->width <= lowerBound + 1.0) {
+
+        Bucket *bucket = &heap->buckets[heap->low];
+
+        for (int i = 0; i < bucket->used; ++i)
+            freeNode(ctx, bucket->data[i]);
+
+        pruned += bucket->used;
+        free(bucket->data);
+        *bucket = (Bucket) { 0, 0, NULL };
+
+        heap->low++;
     }
-   
-   /* place new node at the end of heap and heapify */
-   heap->data[heap->used] = node;
+
+    heap->used -= pruned;
+    if (heap->top < heap->low)
+        heap->top = -1;
+
+    return pruned;
+}
+
+
+/* insert node into its bucket; heap must be locked */
+static void heap_insert(Heap *heap, BabNode *node, double lowerBound) {
+
+   if (heap->numBuckets == 0)
+       init_buckets(heap, lowerBound, node->upper_bound);
+
+   int k = bucket_index(heap, node->upper_bound);
+   Bucket *bucket = &heap->buckets[k];
+
+   if (bucket->used == bucket->size) {
+       bucket->size = (bucket->size > 0) ? 2 * bucket->size : 16;
+       bucket->data = (BabNode **) realloc(bucket->data, bucket->size * sizeof(BabNode*));
+       if (bucket->data == NULL) {
+           fprintf(stderr, "Error: Not enough memory for priority queue.\n");
+           exit(1);
+       }
+   }
+
+   /* place new node at the end of bucket and heapify */
+   bucket->data[bucket->used] = node;
+   bucket->used++;
+
+   heapify_up(bucket, bucket->used - 1);
+
    heap->used++;
+   if (k > heap->top)
+       heap->top = k;
+}
+
+
+/* 
+ * Remove up to max nodes with the lowest priority: nodes are taken from the ends 
+ * of the lowest buckets, which keeps the heap order of the buckets. Heap must be locked.
+ */
+static int heap_detach(Heap *heap, BabNode **nodes, int max) {
+
+    int count = 0;
+
+    for (int k = heap->low; k <= heap->top && count < max; ++k) {
+        Bucket *bucket = &heap->buckets[k];
+        while (bucket->used > 0 && count < max)
+            nodes[count++] = bucket->data[--bucket->used];
+    }
+
+    heap->used -= count;
+    while (heap->top >= heap->low && heap->buckets[heap->top].used == 0)
+        heap->top--;
+    if (heap->top < heap->low)
+        heap->top = -1;
+
+    return count;
+}
+
+
+/* 
+ * Move half of the heap of the worker (at most SPILL_BATCH nodes) to the spill file. 
+ * The heap stays locked until the nodes are written, so a checkpoint always finds
+ * them either in the heap or in the spill file.
+ */
+static void Bab_PQSpill(BiqBinContext *ctx) {
+
+    Heap *heap = ctx->tree->heaps[ctx->worker];
+    BabNode *nodes[SPILL_BATCH];
+    int count;
+
+    pthread_mutex_lock(&heap->lock);
+    count = heap_detach(heap, nodes, (heap->used / 2 < SPILL_BATCH) ? heap->used / 2 : SPILL_BATCH);
+
+    Spill_Write(ctx, nodes, count);
+
+    for (int i = 0; i < count; ++i)
+        freeNode(ctx, nodes[i]);
+    pthread_mutex_unlock(&heap->lock);
+}
+
+
+/* load the best segment of spilled nodes into the heap of the worker */
+static void Bab_PQLoad(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+    Heap *heap = tree->heaps[ctx->worker];
+    BabNode *nodes[SPILL_BATCH];
+    int pruned = 0;
+    double lb = Bab_LBGet(ctx);
+
+    pthread_mutex_lock(&heap->lock);
+    int count = Spill_Read(ctx, nodes);
+    for (int i = 0; i < count; ++i) {
+        // segment may contain nodes that are already pruned
+        if (lb + 1.0 < nodes[i]->upper_bound)
+            heap_insert(heap, nodes[i], lb);
+        else {
+            freeNode(ctx, nodes[i]);
+            ++pruned;
+        }
+    }
+    pthread_mutex_unlock(&heap->lock);
+
+    if (pruned > 0) {
+        pthread_mutex_lock(&tree->idle_lock);
+        tree->pending -= pruned;
+        if (tree->pending == 0 && tree->idleWorkers > 0)
+            pthread_cond_broadcast(&tree->idle_cond);
+        pthread_mutex_unlock(&tree->idle_lock);
+    }
+}
+
+
+/* steal the node with the highest priority among the heaps of the other workers */
+static BabNode* Bab_PQSteal(BiqBinContext *ctx) {
+
+    Heap **heaps = ctx->tree->heaps;
+    int num_workers = ctx->tree->numWorkers;
+    int victim = -1;
+    double best = -BIG_NUMBER;
+    BabNode *node = NULL;
+
+    for (int i = 1; i < num_workers; ++i) {
+        int w = (ctx->worker + i) % num_workers;
+
+        pthread_mutex_lock(&heaps[w]->lock);
+        if (heaps[w]->used > 0 && heap_top(heaps[w])->upper_bound > best) {
+            best = heap_top(heaps[w])->upper_bound;
+            victim = w;
+        }
+        pthread_mutex_unlock(&heaps[w]->lock);
+    }
+
+    if (victim >= 0) {
+        pthread_mutex_lock(&heaps[victim]->lock);
+        if (heaps[victim]->used > 0) {
+            node = heap_pop(heaps[victim]);
+            Checkpoint_SetCurrent(ctx, node);
+        }
+        pthread_mutex_unlock(&heaps[victim]->lock);
+    }
+
+    return node;
+}
+
 
-   heapify_up(heap->used - 1);
+/*
+ * Returns the node with the highest priority from the heap of the calling worker,
+ * or steals one from another worker if its own heap is empty.
+ * Blocks while other workers may still produce nodes and returns NULL
+ * once the whole B&B tree has been processed.
+ */
+BabNode* Bab_PQPop(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+    Heap *heap = tree->heaps[ctx->worker];
+    BabNode *node;
+    int epoch;
+
+    for (;;) {
+
+        pthread_mutex_lock(&tree->idle_lock);
+        epoch = tree->epoch;
+        pthread_mutex_unlock(&tree->idle_lock);
+
+        /* spilled nodes have higher priority than the nodes in memory: load a segment */
+        if (tree->spill != NULL) {
+            pthread_mutex_lock(&heap->lock);
+            double best = (heap->used > 0) ? heap_top(heap)->upper_bound : -BIG_NUMBER;
+            pthread_mutex_unlock(&heap->lock);
+
+            if (Spill_TopBound(ctx) > best)
+                Bab_PQLoad(ctx);
+        }
+
+        node = NULL;
+        pthread_mutex_lock(&heap->lock);
+        if (heap->used > 0) {
+            node = heap_pop(heap);
+            Checkpoint_SetCurrent(ctx, node);
+        }
+        pthread_mutex_unlock(&heap->lock);
+
+        if (node == NULL && tree->numWorkers > 1)
+            node = Bab_PQSteal(ctx);
+
+        if (node != NULL)
+            return node;
+
+        /* nothing to do: finish if no node is left, otherwise wait for new nodes */
+        pthread_mutex_lock(&tree->idle_lock);
+        if (tree->pending == 0) {
+            pthread_cond_broadcast(&tree->idle_cond);
+            pthread_mutex_unlock(&tree->idle_lock);
+            return NULL;
+        }
+        if (epoch == tree->epoch) {
+            ++tree->idleWorkers;
+            pthread_cond_wait(&tree->idle_cond, &tree->idle_lock);
+            --tree->idleWorkers;
+        }
+        pthread_mutex_unlock(&tree->idle_lock);
+    }
+}
+
+
+/* Signal that the node returned by Bab_PQPop has been processed (branched or pruned) */
+void Bab_PQNodeDone(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+
+    Checkpoint_SetCurrent(ctx, NULL);
+
+    pthread_mutex_lock(&tree->idle_lock);
+    --tree->pending;
+    if (tree->pending == 0 && tree->idleWorkers > 0)
+        pthread_cond_broadcast(&tree->idle_cond);
+    pthread_mutex_unlock(&tree->idle_lock);
+}
+
+
+void Bab_PQInsert(BiqBinContext *ctx, BabNode *node) {
+
+    BabTree *tree = ctx->tree;
+    Heap *heap = tree->heaps[ctx->worker];
+
+    /* count the node before it is published: another worker may steal and finish it 
+     * or prune it as soon as it is in the heap */
+    pthread_mutex_lock(&tree->idle_lock);
+    ++tree->pending;
+    pthread_mutex_unlock(&tree->idle_lock);
+
+    pthread_mutex_lock(&heap->lock);
+    heap_insert(heap, node, Bab_LBGet(ctx));
+    Checkpoint_LogNode(ctx, node);
+    pthread_mutex_unlock(&heap->lock);
+
+    /* wake up an idle worker */
+    pthread_mutex_lock(&tree->idle_lock);
+    ++tree->epoch;
+    if (tree->idleWorkers > 0)
+        pthread_cond_signal(&tree->idle_cond);
+    pthread_mutex_unlock(&tree->idle_lock);
+
+    /* open nodes use too much memory: spill nodes with the lowest priority to disk */
+    if (tree->spill != NULL && Bab_nodeMemory(ctx) > tree->params.spill_memory * 1024 * 1024)
+        Bab_PQSpill(ctx);
+}
+
+
+/* size class of a block with at least size bytes: block sizes are 16, 24, 32, 48, 64, 96, ... */
+static int pool_size_class(size_t size, size_t *block) {
+
+    int c = 0;
+
+    *block = 16;
+    while (*block < size) {
+        ++c;
+        *block = (size_t) ((c & 1) ? 24 : 16) << (c >> 1);
+    }
+
+    if (c >= POOL_NUM_CLASSES) {
+        fprintf(stderr, "Error: Size of B&B node (%zu bytes) exceeds the node pool.\n", size);
+        exit(1);
+    }
+
+    return c;
+}
+
+
+/* take a block of at least size bytes from the pool: free list first, then the current slab */
+static void *pool_alloc(NodePool *pool, size_t size) {
+
+    size_t block;
+    PoolClass *cls = &pool->classes[pool_size_class(size, &block)];
+    void *ptr;
+
+    if (cls->free != NULL) {
+        ptr = cls->free;
+        cls->free = *(void **) ptr;
+        return ptr;
+    }
+
+    // current slab is used up: allocate new one
+    if (cls->bump + block > cls->end) {
+        size_t bytes = (block > POOL_SLAB_SIZE) ? block : POOL_SLAB_SIZE - POOL_SLAB_SIZE % block;
+
+        PoolSlab *slab = (PoolSlab *) malloc(sizeof(PoolSlab) + bytes);
+        if (slab == NULL) {
+            fprintf(stderr, "Error: Not enough memory for creating new node.\n");
+            exit(1);
+        }
+
+        slab->size = bytes;
+        slab->next = pool->slabs;
+        pool->slabs = slab;
+        ++pool->numSlabs;
+        pool->slabBytes += bytes;
+
+        cls->bump = slab->data;
+        cls->end = slab->data + bytes;
+    }
+
+    ptr = cls->bump;
+    cls->bump += block;
+
+    return ptr;
+}
+
+
+/* return block of size bytes to the free list of its size class */
+static void pool_free(NodePool *pool, void *ptr, size_t size) {
+
+    size_t block;
+    PoolClass *cls = &pool->classes[pool_size_class(size, &block)];
+
+    *(void **) ptr = cls->free;
+    cls->free = ptr;
+}
+
+
+static inline size_t node_size(int words) {
+    return sizeof(BabNode) + 2 * words * sizeof(uint64_t);
+}
+
+
+/* highest upper bound among the nodes in the heaps of all workers (-BIG_NUMBER if empty) */
+double Bab_PQBestBound(BiqBinContext *ctx) {
+
+    Heap **heaps = ctx->tree->heaps;
+    double best = -BIG_NUMBER;
+
+    for (int w = 0; w < ctx->tree->numWorkers; ++w) {
+        pthread_mutex_lock(&heaps[w]->lock);
+        if (heaps[w]->used > 0 && heap_top(heaps[w])->upper_bound > best)
+            best = heap_top(heaps[w])->upper_bound;
+        pthread_mutex_unlock(&heaps[w]->lock);
+    }
+
+    return best;
+}
+
+
+/* 
+ * Called after the global lower bound improved: frees the nodes in the heaps 
+ * of all workers that can no longer contain a better solution.
+ */
+void Bab_PQPrune(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+    int pruned = 0;
+
+    for (int w = 0; w < tree->numWorkers; ++w) {
+        pthread_mutex_lock(&tree->heaps[w]->lock);
+        pruned += heap_prune(ctx, tree->heaps[w], Bab_LBGet(ctx));
+        pthread_mutex_unlock(&tree->heaps[w]->lock);
+    }
+
+    pruned += Spill_Prune(ctx, Bab_LBGet(ctx));
+
+    if (pruned == 0)
+        return;
+
+    pthread_mutex_lock(&tree->idle_lock);
+    tree->pending -= pruned;
+    if (tree->pending == 0 && tree->idleWorkers > 0)
+        pthread_cond_broadcast(&tree->idle_cond);
+    pthread_mutex_unlock(&tree->idle_lock);
 }
 
 
@@ -139,25 +654,34 @@ void Bab_PQInsert(BabNode *node) {
  * If parentNode == NULL, it will create the root node.
  * Otherwise, the new node will be a child of parentNode.
  */
-// NOTE: Bab_GenChild will place created child node in priority queue
-BabNode* newNode(BabNode *parentNode) {
+// NOTE: Bab_GenChild will place created child node in priority queue (or dive into it)
+BabNode* newNode(const BiqBinContext *ctx, BabNode *parentNode) {
 
-    // allocate memory for the new child node
-    BabNode *node = (BabNode *) malloc(sizeof(BabNode));
-    if (node == NULL) {
-        fprintf(stderr, "Error: Not enough memory for creating new node.\n");
-        exit(1);
-    }
+    int words = BAB_WORDS(ctx->tree->BabPbSize);
+
+    // take memory for the new child node from the pool of the worker: header + bitsets xfixed and sol
+    BabNode *node = (BabNode *) pool_alloc(&ctx->tree->pools[ctx->worker], node_size(words));
+
+    // update peak number of nodes
+    int live = atomic_fetch_add(&ctx->tree->liveNodes, 1) + 1;
+    int peak = atomic_load(&ctx->tree->peakNodes);
+    while (live > peak && !atomic_compare_exchange_weak(&ctx->tree->peakNodes, &peak, live))
+        ;
+
+    node->words = words;
+    node->warm = NULL;
+    node->branch_var = -1;
+    node->branch_frac = 0.0f;
 
-    // copy the solution information from the parent node
-    for (int i = 0; i < BabPbSize; ++i) {
+    // copy the solution information from the parent node (word by word)
+    for (int w = 0; w < words; ++w) {
         if (parentNode == NULL) {
-            node->xfixed[i] = 0;
-            node->sol.X[i] = 0;
+            node->bits[w] = 0;
+            node->bits[words + w] = 0;
         }
         else {
-            node->xfixed[i] = parentNode->xfixed[i];
-            node->sol.X[i] = (node->xfixed[i]) ? parentNode->sol.X[i] : 0;
+            node->bits[w] = parentNode->bits[w];
+            node->bits[words + w] = parentNode->bits[words + w] & parentNode->bits[w];
         }
     }
 
@@ -168,26 +692,135 @@ BabNode* newNode(BabNode *parentNode) {
 }
 
 
+/* Memory used by open B&B nodes (node, its entry in the priority queue and its starting point) */
+size_t Bab_nodeMemory(const BiqBinContext *ctx) {
+    
+    size_t block;
+    pool_size_class(node_size(BAB_WORDS(ctx->tree->BabPbSize)), &block);
+
+    return (size_t) atomic_load(&ctx->tree->liveNodes) * (block + sizeof(BabNode*)) + 
+           atomic_load(&ctx->tree->warmMemory);
+}
+
+
+/*
+ * Keep the final point of ipm_mc_pk (ctx->ipm_cur, params.ipm_warm_start) and the final cuts
+ * (ctx->cuts_cur, params.cut_warm_start) of the evaluated node with the node, so its children
+ * start from them when the node is branched.
+ */
+void keepWarmStart(const BiqBinContext *ctx, BabNode *node) {
+
+    const IPMPoint *cur = ctx->tree->params.ipm_warm_start ? ctx->ipm_cur : NULL;
+    const CutSet *cuts = ctx->tree->params.cut_warm_start ? ctx->cuts_cur : NULL;
+    size_t n = (cur != NULL) ? cur->n : 0;
+    size_t tri = 0, pent = 0, hepta = 0;
+
+    if (cuts != NULL) {
+        tri = cuts->NIneq;
+        pent = cuts->NPentIneq;
+        hepta = cuts->NHeptaIneq;
+    }
+
+    if (n + tri + pent + hepta == 0)
+        return;
+
+    // doubles first, then the cuts (aligned like doubles) and the ints
+    size_t bytes = sizeof(NodeWarmStart) + (n * n + n) * sizeof(double) + 
+                   tri * sizeof(Triangle_Inequality) + pent * sizeof(Pentagonal_Inequality) +
+                   hepta * sizeof(Heptagonal_Inequality) + n * sizeof(int);
+    NodeWarmStart *warm = (NodeWarmStart *) malloc(bytes);
+
+    // without memory the children simply start from scratch
+    if (warm == NULL)
+        return;
+
+    warm->bytes = bytes;
+    warm->ipm.n = n;
+    warm->ipm.X = (double *) (warm + 1);
+    warm->ipm.y = warm->ipm.X + n * n;
+    warm->cuts.NIneq = tri;
+    warm->cuts.NPentIneq = pent;
+    warm->cuts.NHeptaIneq = hepta;
+    warm->cuts.Cuts = (Triangle_Inequality *) (warm->ipm.y + n);
+    warm->cuts.Pent_Cuts = (Pentagonal_Inequality *) (warm->cuts.Cuts + tri);
+    warm->cuts.Hepta_Cuts = (Heptagonal_Inequality *) (warm->cuts.Pent_Cuts + pent);
+    warm->ipm.vars = (int *) (warm->cuts.Hepta_Cuts + hepta);
+
+    if (n > 0) {
+        memcpy(warm->ipm.X, cur->X, n * n * sizeof(double));
+        memcpy(warm->ipm.y, cur->y, n * sizeof(double));
+        memcpy(warm->ipm.vars, cur->vars, n * sizeof(int));
+    }
+    if (cuts != NULL) {
+        memcpy(warm->cuts.Cuts, cuts->Cuts, tri * sizeof(Triangle_Inequality));
+        memcpy(warm->cuts.Pent_Cuts, cuts->Pent_Cuts, pent * sizeof(Pentagonal_Inequality));
+        memcpy(warm->cuts.Hepta_Cuts, cuts->Hepta_Cuts, hepta * sizeof(Heptagonal_Inequality));
+    }
+
+    node->warm = warm;
+    atomic_fetch_add(&ctx->tree->warmMemory, bytes);
+}
+
+
+/* Release node (branched or pruned); the node may have been created by another worker */
+void freeNode(const BiqBinContext *ctx, BabNode *node) {
+
+    if (node->warm != NULL) {
+        atomic_fetch_sub(&ctx->tree->warmMemory, node->warm->bytes);
+        free(node->warm);
+    }
+
+    pool_free(&ctx->tree->pools[ctx->worker], node, node_size(node->words));
+    atomic_fetch_sub(&ctx->tree->liveNodes, 1);
+}
+
+
+/* Store the values of the fixed variables of node in x (0 for variables that are not fixed) */
+void getNodeSolution(const BiqBinContext *ctx, const BabNode *node, int *x) {
+
+    for (int i = 0; i < ctx->tree->BabPbSize; ++i)
+        x[i] = Bab_solValue(node, i);
+}
+
+
 /* Allocate and initialize global lower bound and solution vector */
-void Bab_LBInit(double lowerBound, BabSolution *bs) {
+void Bab_LBInit(BiqBinContext *ctx, double lowerBound, const int *x) {
 
-    BabSol = (BabSolution *) malloc(sizeof(BabSolution));
-    if (BabSol == NULL) {
+    BabTree *tree = ctx->tree;
+    int n = tree->BabPbSize;
+
+    tree->BabSol = (BabSolution *) malloc(sizeof(BabSolution) + n * sizeof(int));
+    if (tree->BabSol == NULL) {
         fprintf(stderr, "Not enough memory for BabSol.\n");
         exit(1);
     }
-    *BabSol = *bs;
-    BabLB = lowerBound;
+    tree->BabSol->n = n;
+    memcpy(tree->BabSol->X, x, n * sizeof(int));
+    atomic_store(&tree->BabLB, lowerBound);
 }
 
 
 /* If new solution is better than the global solution, update the solution */
-int Bab_LBUpd(double new_LB, BabSolution *bs) {
+int Bab_LBUpd(BiqBinContext *ctx, double new_LB, const int *x) {
+
+    BabTree *tree = ctx->tree;
+    int updated = 0;
 
-    if (new_LB > BabLB) {
-        BabLB = new_LB;
-        *BabSol = *bs;
-        return 1;
+    // cheap test without locking: most candidate solutions are not better
+    if (new_LB <= atomic_load(&tree->BabLB))
+        return 0;
+
+    pthread_mutex_lock(&tree->lb_lock);
+    if (new_LB > atomic_load(&tree->BabLB)) {
+        atomic_store(&tree->BabLB, new_LB);
+        memcpy(tree->BabSol->X, x, tree->BabSol->n * sizeof(int));
+        updated = 1;
     }
-    return 0;
+    pthread_mutex_unlock(&tree->lb_lock);
+
+    // free nodes that are pruned by the new lower bound
+    if (updated)
+        Bab_PQPrune(ctx);
+
+    return updated;
 }
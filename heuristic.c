@@ -4,13 +4,12 @@
 
 #include "biqbin.h"
 
-extern double *X;
-extern double *Z;       // stores Cholesky decomposition: X = ZZ^T
+double runHeuristic(BiqBinContext *ctx, BabNode *node, int *x) {
 
-double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
-
-    // Problem *P0 ... the original problem
-    // Problem *P  ... the current subproblem
+    Problem *P0 = ctx->tree->SP;    // the original problem
+    Problem *P = ctx->PP;           // the current subproblem
+    double *X = ctx->X;
+    double *Z = ctx->Z;             // stores Cholesky decomposition: X = ZZ^T
     // int *x      ... current best feasible solution 
 
     int n = P->n;
@@ -31,7 +30,7 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
             Z[j + i*n] = 0.0;
 
     // Goemans-Williamson heuristic
-    heur_val = GW_heuristic(P0, P, node, x, P0->n);
+    heur_val = GW_heuristic(ctx, node, x, P0->n);
 
     return heur_val;    
 
@@ -51,14 +50,14 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
     
     // generate first random cut vector {-1,1}^n
     for (int i = 0; i < n; ++i)
-        xh[i] = 2 * (rand() % 2) - 1; 
+        xh[i] = 2 * (Bab_random(ctx) % 2) - 1; 
 
     // compute its objective value (store in temp_x and transform to {0,1})
     index = 0;
     for (int i = 0; i < N; ++i) {
 
-        if (node->xfixed[i]) 
-            temp_x[i] = node->sol.X[i];
+        if (Bab_isFixed(node, i)) 
+            temp_x[i] = Bab_solValue(node, i);
 
         else {
             temp_x[i] = (xh[index] + 1) / 2.0;
@@ -66,7 +65,7 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
         }
     }
 
-    double fh = evaluateSolution(temp_x);
+    double fh = evaluateSolution(ctx, temp_x);
 
     int done = 0;
     double constant;    // scalar in convex combiantion
@@ -94,7 +93,7 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
                 Z[j + i*n] = 0.0;
 
         // Goemans-Williamson heuristic
-        heur_val = GW_heuristic(P0, P, node, x, P0->n);
+        heur_val = GW_heuristic(ctx, node, x, P0->n);
 
         if (heur_val > fh) {
 
@@ -106,7 +105,7 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
             index = 0;
             for (int i = 0; i < N; ++i) {
 
-                if (!node->xfixed[i]) {
+                if (!Bab_isFixed(node, i)) {
                     xh[index] = 2 * x[i] - 1;
                     ++index;
                 }
@@ -115,7 +114,7 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
                       
         }
 
-        constant = 0.3 + 0.6 * ( (double)rand()/(double)(RAND_MAX) );
+        constant = 0.3 + 0.6 * ( (double)Bab_random(ctx)/(double)(RAND_MAX) );
 
         // Z = (1-constant)*X + constant* xh *xh'
         alpha = 1.0 - constant;
@@ -132,10 +131,11 @@ double runHeuristic(Problem *P0, Problem *P, BabNode *node, int *x) {
 
 
 /* Goemans-Williamson random hyperplane heuristic */
-double GW_heuristic(Problem *P0, Problem *P, BabNode *node, int *x, int num) {
+double GW_heuristic(BiqBinContext *ctx, BabNode *node, int *x, int num) {
 
-    // Problem *P0 ... the original problem
-    // Problem *P  ... the current subproblem
+    Problem *P0 = ctx->tree->SP;    // the original problem
+    Problem *P = ctx->PP;           // the current subproblem
+    double *Z = ctx->Z;             // Cholesky factor of X
     //         num ... number of random hyperplanes
 
     int index;
@@ -156,7 +156,7 @@ double GW_heuristic(Problem *P0, Problem *P, BabNode *node, int *x, int num) {
 
         // compute random hyperplane v
         for (int i = 0; i < N; ++i) 
-            v[i] = ( (double)rand() / (double)(RAND_MAX) ) - 0.5;
+            v[i] = ( (double)Bab_random(ctx) / (double)(RAND_MAX) ) - 0.5;
 
         // compute cut temp_x generated by hyperplane v
         index = 0;
@@ -186,15 +186,15 @@ double GW_heuristic(Problem *P0, Problem *P, BabNode *node, int *x, int num) {
         // store local cut temp_x into global cut sol
         index = 0;
         for (int i = 0; i < P0->n-1; ++i) {
-            if (node->xfixed[i]) 
-                sol[i] = node->sol.X[i];
+            if (Bab_isFixed(node, i)) 
+                sol[i] = Bab_solValue(node, i);
             else {
                 sol[i] = (temp_x[index]+1)/2;
                 ++index;
             }
         }
 
-        update_best(x, sol, &best, P0);
+        update_best(ctx, x, sol, &best);
       
     }
 
@@ -317,12 +317,12 @@ double mc_1opt(int *x, Problem *P) {
  * the objective value of xnew, then replaces xbest with xnew if
  * xnew is better. Also updates the best objective value, best.
  */
-int update_best(int *xbest, int *xnew, double *best, Problem *P0) {
+int update_best(const BiqBinContext *ctx, int *xbest, int *xnew, double *best) {
 
     int success = 0;
-    int N = P0->n - 1; // N = BabPbSize
+    int N = ctx->tree->BabPbSize;
 
-    double heur_val = evaluateSolution(xnew);
+    double heur_val = evaluateSolution(ctx, xnew);
 
     if ( *best < heur_val ) {
         memcpy(xbest, xnew, sizeof(int) * N);
@@ -7,11 +7,14 @@
  *                                                                       *
  * input:  L    ... objective matrix                                     *
  *         n    ... size of the problem                                  *
+ *         warm ... start from X and y (otherwise X = I, y = 1.1+sum|L|) *
+ *         prune_below ... stop if phi < prune_below (node is pruned)    *
+ *         keep_above  ... stop if psi > keep_above and gap < 0.5        *
  *         print... print level                                          *
  * output: phi  ... optimal value of SDP (value of the dual problem)     *
  *         X    ... optimal primal matrix                                *
  *         y    ... optimal dual vector                                  *   
- *         Z    ... optimal dual matrix                                  *
+ * returns IPM_CONVERGED, IPM_PRUNE or IPM_NO_PRUNE                      *
  *************************************************************************/
 
 
@@ -25,7 +28,300 @@
 /* NOTE: C uses row-major, but blas and lapack routines (written in Fortran)
  * use column-major --> be careful when multiplying non-symmetric matrices) */
 
-void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
+/* warm starting point is accepted if lambda_min(XZ) >= IPM_CENTRALITY * <X,Z>/n */
+#define IPM_CENTRALITY 0.01
+
+/* duality gap that is accepted when the node cannot be pruned (keep_above) */
+#define IPM_KEEP_GAP 0.5
+
+/* weights of the cold starting point that are tried when the warm point is not centered */
+static const double blend[] = { 0.0, 0.03, 0.1, 0.3 };
+
+/* mixed precision: single precision iterations until the gap is below IPM_SWITCH_GAP * (1 + |phi|) */
+#define IPM_SWITCH_GAP 1e-3
+#define IPM_SINGLE_MAX_ITER 50
+
+
+/* 
+ * Centrality test of the starting point: returns 1 if X and Z are positive definite 
+ * and the smallest eigenvalue of XZ is at least IPM_CENTRALITY times the average one.
+ * Eigenvalues of XZ are the eigenvalues of R*Z*R', where X = R'*R. 
+ * R and W are n x n work matrices.
+ */
+static int well_centered(IPMWorkspace *ws, const double *X, const double *Z, int n, double *R, double *W) {
+
+    int nn = n * n;
+    int inc = 1;
+    int info;
+    char up = 'U';
+    double one = 1.0;
+
+    dcopy_(&nn, (double *) X, &inc, R, &inc);
+    dpotrf_(&up, &n, R, &n, &info);
+    if (info != 0)
+        return 0;
+
+    /* W = R * Z * R' */
+    char left = 'L', right = 'R', notrans = 'N', trans = 'T', nonunit = 'N';
+    dcopy_(&nn, (double *) Z, &inc, W, &inc);
+    dtrmm_(&left, &up, &notrans, &nonunit, &n, &n, &one, R, &n, W, &n);
+    dtrmm_(&right, &up, &trans, &nonunit, &n, &n, &one, R, &n, W, &n);
+
+    /* smallest eigenvalue of W */
+    char jobz = 'N', range = 'I';
+    int il = 1, iu = 1, m;
+    double vl = 0.0, vu = 0.0, abstol = 0.0, lambda_min, z;
+    int isuppz[2];
+
+    dsyevr_(&jobz, &range, &up, &n, W, &n, &vl, &vu, &il, &iu, &abstol, &m, 
+            &lambda_min, &z, &inc, isuppz, ws->work, &ws->lwork, ws->iwork, &ws->liwork, &info);
+
+    return info == 0 && lambda_min >= IPM_CENTRALITY * ddot_(&nn, (double *) X, &inc, (double *) Z, &inc) / n;
+}
+
+
+
+/* returns 1 if X and Z are positive definite (R is a n x n work matrix) */
+static int interior(const double *X, const double *Z, int n, double *R) {
+
+    int nn = n * n;
+    int inc = 1;
+    int info;
+    char up = 'U';
+
+    dcopy_(&nn, (double *) X, &inc, R, &inc);
+    dpotrf_(&up, &n, R, &n, &info);
+    if (info != 0)
+        return 0;
+
+    dcopy_(&nn, (double *) Z, &inc, R, &inc);
+    dpotrf_(&up, &n, R, &n, &info);
+
+    return info == 0;
+}
+
+
+/*
+ * Centrality safeguard: the starting point (X,y) is stored in (ws->dX,ws->dy) and moved towards 
+ * the cold start (I,y0) with the weights blend[first], blend[first+1], ... until it is well centered
+ * (or only interior if center == 0). Sets Z = Diag(y) - L. Returns 0 if no weight is accepted.
+ */
+static int blend_start(IPMWorkspace *ws, double *L, int n, double *X, double *y, double *Z, const double *y0, int first, int center) {
+
+    int nn = n * n;
+    int inc = 1;
+    int centered = 0;
+    double alpha = -1.0;
+    double *dX = ws->dX, *dy = ws->dy;
+
+    dcopy_(&nn,X,&inc,dX,&inc);
+    dcopy_(&n,y,&inc,dy,&inc);
+
+    for (int k = first; k < (int) (sizeof(blend) / sizeof(blend[0])) && !centered; ++k) {
+
+        /* X = (1-t)*Xw + t*I, y = (1-t)*yw + t*y0 */
+        for (int j = 0; j < nn; ++j)
+            X[j] = (1.0 - blend[k]) * dX[j];
+        for (int j = 0; j < n; ++j) {
+            X[j + j*n] += blend[k];
+            y[j] = (1.0 - blend[k]) * dy[j] + blend[k] * y0[j];
+        }
+
+        /* Z = Diag(y) - L */
+        Diag(Z, y, n);
+        daxpy_(&nn,&alpha,L,&inc,Z,&inc);
+
+        centered = center ? well_centered(ws, X, Z, n, ws->tmp, ws->tmp2) : interior(X, Z, n, ws->tmp);
+    }
+
+    return centered;
+}
+
+
+/* X = I, y = y0 and Z = Diag(y) - L */
+static void cold_start(IPMWorkspace *ws, double *L, int n, double *X, double *y, double *Z, const double *y0) {
+
+    int nn = n * n;
+    int inc = 1;
+    double alpha = -1.0;
+
+    /* y = y0 */
+    dcopy_(&n,(double *) y0,&inc,y,&inc);
+
+    /* X = eye(n) = Diag(b) */
+    Diag(X, ws->b, n);
+
+    /* Z = Diag(y) - L */
+    Diag(Z, y, n);                           /* Z = Diag(y) */
+    daxpy_(&nn,&alpha,L,&inc,Z,&inc);        /* Z = Z - L */
+}
+
+
+/*
+ * Single precision version of the iterations of ipm_mc_pk (see below), used for the first
+ * iterations in the mixed precision mode. Starts from (X,y) and returns the last point in 
+ * (X,y) once the duality gap is below IPM_SWITCH_GAP * (1 + |phi|). Values are accumulated 
+ * in double. Returns the number of iterations, or -1 if a factorization failed 
+ * (X and y are then not changed).
+ */
+static int ipm_single(IPMWorkspace *ws, const double *L, int n, double *X, double *y) {
+
+    int inc = 1;
+    char up = 'U';
+    char side = 'L';
+    int info;
+    float one = 1.0f, zero = 0.0f;
+    int i, j, k;
+    double phi, psi, gap, mu;
+    float alpha_p, alpha_d;
+
+    int nn = n * n;
+    float *sL = ws->sL, *sX = ws->sX, *sZ = ws->sZ, *sZi = ws->sZi, *sM = ws->sM;
+    float *sdX = ws->sdX, *sdX1 = ws->sdX1, *stmp = ws->stmp;
+    float *sy = ws->sy, *sdy = ws->sdy, *sdy1 = ws->sdy1;
+
+    /* convert starting point, Z = Diag(y) - L */
+    for (j = 0; j < nn; ++j) {
+        sL[j] = (float) L[j];
+        sX[j] = (float) X[j];
+        sZ[j] = -sL[j];
+    }
+    for (j = 0; j < n; ++j) {
+        sy[j] = (float) y[j];
+        sZ[j+n*j] += sy[j];
+    }
+
+    phi = psi = mu = 0.0;
+    for (j = 0; j < n; ++j)
+        phi += sy[j];
+    for (j = 0; j < nn; ++j) {
+        psi += (double) sL[j] * sX[j];
+        mu += (double) sZ[j] * sX[j];
+    }
+    mu /= 2.0 * n;
+    gap = fabs(phi - psi);
+
+    for (i = 0; i < IPM_SINGLE_MAX_ITER && gap > IPM_SWITCH_GAP * (1.0 + fabs(phi)); ++i) {
+
+        /* Zi = inv(Z) */
+        memcpy(sZi, sZ, nn * sizeof(float));
+        spotrf_(&up,&n,sZi,&n,&info);
+        if (info == 0)
+            spotri_(&up,&n,sZi,&n,&info);
+        if (info != 0)
+            return -1;
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k < j; ++k)
+                sZi[j+n*k] = sZi[k+n*j];
+        }
+
+        /* Schur complement M = Zi .* X (upper triangle) */
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k <= j; ++k)
+                sM[k+n*j] = sZi[k+n*j] * sX[k+n*j];
+        }
+        spotrf_(&up,&n,sM,&n,&info);
+        if (info != 0)
+            return -1;
+
+        /* predictor: dy1 = M \ (-e), dX1 = -Zi*diag(dy1)*X - X */
+        for (j = 0; j < n; ++j)
+            sdy1[j] = -1.0f;
+        spotrs_(&up,&n,&inc,sM,&n,sdy1,&n,&info);
+
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k < n; ++k)
+                stmp[k+n*j] = -sdy1[k] * sX[k+n*j];
+        }
+        ssymm_(&side,&up,&n,&n,&one,sZi,&n,stmp,&n,&zero,sdX1,&n);
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k <= j; ++k)
+                sdX1[k+n*j] = sdX1[j+n*k] = 0.5f * ((sdX1[j+n*k] - sX[j+n*k]) + (sdX1[k+n*j] - sX[k+n*j]));
+        }
+
+        /* corrector: dy2 = M \ (mu*diag(Zi) - (Zi .* dX1)*dy1) */
+        for (j = 0; j < n; ++j)
+            sdy[j] = (float) mu * sZi[j+n*j];
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k < n; ++k)
+                sdy[k] -= sZi[k+n*j] * sdX1[k+n*j] * sdy1[j];
+        }
+        spotrs_(&up,&n,&inc,sM,&n,sdy,&n,&info);
+
+        /* dX = dX1 + mu*Zi - Zi*(diag(dy2)*X + diag(dy1)*dX1), symmetrized */
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k < n; ++k)
+                stmp[k+n*j] = -sdy[k] * sX[k+n*j] - sdy1[k] * sdX1[k+n*j];
+        }
+        ssymm_(&side,&up,&n,&n,&one,sZi,&n,stmp,&n,&zero,sdX,&n);
+        for (j = 0; j < n; ++j) {
+            sdy[j] += sdy1[j];
+            for (k = 0; k <= j; ++k)
+                sdX[k+n*j] = sdX[j+n*k] = 0.5f * ((sdX[j+n*k] + (float) mu * sZi[j+n*k] + sdX1[j+n*k]) + 
+                                                  (sdX[k+n*j] + (float) mu * sZi[k+n*j] + sdX1[k+n*j]));
+        }
+
+        /* line searches (give up if the step gets too short) */
+        for (alpha_p = 1.0f, info = 1; info != 0; ) {
+            for (j = 0; j < n; ++j) {
+                for (k = 0; k <= j; ++k)
+                    stmp[k+n*j] = sX[k+n*j] + alpha_p * sdX[k+n*j];
+            }
+            spotrf_(&up,&n,stmp,&n,&info);
+            if (info != 0 && (alpha_p *= 0.8f) < 1e-4f)
+                return -1;
+        }
+        if (alpha_p < 1.0f)
+            alpha_p *= 0.95f;
+
+        for (alpha_d = 1.0f, info = 1; info != 0; ) {
+            for (j = 0; j < n; ++j) {
+                for (k = 0; k < j; ++k)
+                    stmp[k+n*j] = sZ[k+n*j];
+                stmp[j+n*j] = sZ[j+n*j] + alpha_d * sdy[j];
+            }
+            spotrf_(&up,&n,stmp,&n,&info);
+            if (info != 0 && (alpha_d *= 0.8f) < 1e-4f)
+                return -1;
+        }
+        if (alpha_d < 1.0f)
+            alpha_d *= 0.95f;
+
+        /* update */
+        for (j = 0; j < nn; ++j)
+            sX[j] += alpha_p * sdX[j];
+        for (j = 0; j < n; ++j) {
+            sy[j] += alpha_d * sdy[j];
+            sZ[j+n*j] += alpha_d * sdy[j];
+        }
+
+        phi = psi = mu = 0.0;
+        for (j = 0; j < n; ++j)
+            phi += sy[j];
+        for (j = 0; j < nn; ++j) {
+            psi += (double) sL[j] * sX[j];
+            mu += (double) sZ[j] * sX[j];
+        }
+        mu /= 2.0 * n;
+
+        /* speed up for long steps */
+        if (alpha_p + alpha_d > 1.6f)
+            mu *= 0.5;
+        if (alpha_p + alpha_d > 1.9f)
+            mu *= 0.2;
+
+        gap = fabs(phi - psi);
+    }
+
+    for (j = 0; j < nn; ++j)
+        X[j] = sX[j];
+    for (j = 0; j < n; ++j)
+        y[j] = sy[j];
+
+    return i;
+}
+
+int ipm_mc_pk(IPMWorkspace *ws, double *L, int n, double *X, double *y, double *phi, int warm, double prune_below, double keep_above, int print) {
 
     /* variables for blas and lapack routines */
     int inc = 1;
@@ -41,33 +337,32 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
     double psi;                 // value of primal problem
     double mu;                  // ZX = mu * I (parametrized optimality condition)
     double alpha_p, alpha_d;    // step lengths
+    int factored = 0;           // tmp contains the Cholesky factor of Z
+    int status = IPM_CONVERGED;
 
-    /* dual variables */
-    double *y;                  // dual variable to diagonal constraints
-    double *Z;                  // dual variable to X >= 0
+    /* dual variables (work arrays are taken from ws, no allocation in the solver) */
+    double *Z = ws->Z;          // dual variable to X >= 0
 
-    double *b;                  // vector of ones
-    double *dX, *dy, *dZ;       
-    double *Zi;                 // inv(Z)
-    double *M;                  // M * dy = rhs
-    double *dy1, *dX1;
-    double *tmp, *tmp2;         // need non-symm matrices when computing for instance Zi*diag(dy)*X       
+    double *b = ws->b;          // vector of ones
+    double *dX = ws->dX, *dy = ws->dy;       
+    double *Zi = ws->Zi;        // inv(Z)
+    double *M = ws->M;          // M * dy = rhs
+    double *dy1 = ws->dy1, *dX1 = ws->dX1;
+    double *tmp = ws->tmp;                     // need non-symm matrices when computing for instance Zi*diag(dy)*X       
 
     /*************************************************
      * initial positive definite matrices X, Z and y *
      * primal, dual cost, gap                         *
      *************************************************/
-    alloc_vector(y, n, double);
-    alloc_matrix(Z, n, double);
-
     int nn = n*n;
 
-    /* set y to zero vector */
+    /* cold start y0 is stored in dy1 */
+    /* set y0 to zero vector */
     for (int i = 0; i < n; ++i)
-        y[i] = 0.0;
+        dy1[i] = 0.0;
 
-    /* y = 1.1 + sum(abs(L))' */
-    for (i = 1, p = L, p2 = y; i <= nn; ++i, ++p) {
+    /* y0 = 1.1 + sum(abs(L))' */
+    for (i = 1, p = L, p2 = dy1; i <= nn; ++i, ++p) {
         *p2 += fabs(*p);
         if ((i % n) == 0) {
             *p2 += 1.1;
@@ -76,18 +371,17 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
     }
 
     /* vector b of all ones */
-    alloc_vector(b, n, double);
     for (i = 0; i < n; ++i)
         b[i] = 1.0;
     
-    /* X = eye(n) = Diag(b) */
-    Diag(X, b, n);
-
-    /* Z = Diag(y) - L */
-    Diag(Z, y, n);                           /* Z = Diag(y) */
-    alpha = -1.0;
-    daxpy_(&nn,&alpha,L,&inc,Z,&inc);        /* Z = Z - L */
+    /* warm start (moved towards the cold start if it is not centered) or cold start */
+    if (!warm || !blend_start(ws, L, n, X, y, Z, dy1, 1, 1))
+        cold_start(ws, L, n, X, y, Z, dy1);
 
+    /* mixed precision: first iterations in single precision, then continue in double 
+     * from their last point (moved towards the cold start if it is not interior in double) */
+    if (ws->mixed && ipm_single(ws, L, n, X, y) > 0 && !blend_start(ws, L, n, X, y, Z, dy1, 0, 0))
+        cold_start(ws, L, n, X, y, Z, dy1);
 
     /* phi = ones(n,1)'*y */                 /* initial dual value */
     *phi = ddot_(&n,b,&inc,y,&inc);
@@ -105,19 +399,6 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         puts("*******************************************"); 
     }
 
-    /*  allocate space */
-    alloc_matrix(dX, n, double);
-    alloc_vector(dy, n, double);
-    alloc_matrix(dZ, n, double);
-
-    alloc_vector(dy1, n, double);
-    alloc_matrix(dX1, n, double);
-    alloc_matrix(tmp, n, double);
-    alloc_matrix(tmp2, n, double);
-
-    alloc_matrix(Zi, n, double);    
-    alloc_matrix(M, n, double);   
-
     /*************
      * main loop *
      *************/
@@ -126,14 +407,18 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
     for (i = 1; gap > 1e-2; ++i) {/* while duality gap too large */
         
         /******** compute inverse of Z ********/
-        dcopy_(&nn,Z,&inc,Zi,&inc);         /* copy Z to Zi */   
-
-        dpotrf_(&up,&n,Zi,&n,&info);        /* computes Cholesky factorization */
-        if (info != 0) {
-            fprintf(stderr, "%s: Problem with Cholesky factorization \
-                (line: %d).\n", __func__, __LINE__);
-            exit(EXIT_FAILURE);
+        /* the Cholesky factor of Z is left in tmp by the dual line search if alpha_d = 1 */
+        if (!factored) {
+            dcopy_(&nn,Z,&inc,tmp,&inc);        /* copy Z to tmp */   
+
+            dpotrf_(&up,&n,tmp,&n,&info);       /* computes Cholesky factorization */
+            if (info != 0) {
+                fprintf(stderr, "%s: Problem with Cholesky factorization \
+                    (line: %d).\n", __func__, __LINE__);
+                exit(EXIT_FAILURE);
+            }
         }
+        dcopy_(&nn,tmp,&inc,Zi,&inc);
 
         dpotri_(&up,&n,Zi,&n,&info);        /* computes Zi = inv(Z) */
         if (info != 0) {
@@ -149,28 +434,28 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
                 Zi[j+n*k] = Zi[k+n*j];
         }
 
+        /******** Schur complement M = Zi .* X (upper triangle), factored once for both steps ********/
+        for (j = 0; j < n; ++j) {
+            for (k = 0; k <= j; ++k)
+                M[k+n*j] = Zi[k+n*j] * X[k+n*j];
+        }
 
-        /********   predictor step (mu = 0) solves:       ********
-         ********   Z * X + Diag(dy1) * X + Z * dX1 = 0   ********/
+        dpotrf_(&up,&n,M,&n,&info);
+        if (info != 0) {
+            fprintf(stderr, "%s: problem with Cholesky factorization of Schur complement \
+                (line: %d).\n", __func__, __LINE__);
+            exit(EXIT_FAILURE);
+        }
 
-        /* M = Zi .* X */
-        for (j = 0, p = M; j < nn; ++j, ++p)
-            *p = Zi[j] * X[j];
 
-        /* copy -b to dy1 */
-        alpha = -1.0;
-        dcopy_(&n,b,&inc,dy1,&inc);  // copy
-        dscal_(&n,&alpha,dy1,&inc);  // scale     
+        /********   predictor step (mu = 0) solves:       ********
+         ********   Z * X + Diag(dy1) * X + Z * dX1 = 0   ********/
 
         /* solve the system: dy1 = (Zi .* X) \ (-e) */
-        dposv_(&up, &n, &inc, M, &n, dy1, &n, &info);
-        /* NOTE: M and dy1 are changed on exit! */
+        for (j = 0; j < n; ++j)
+            dy1[j] = -b[j];
 
-        if (info != 0) {
-            fprintf(stderr, "%s: predictor step: problem in solving linear system \
-                (line: %d).\n", __func__, __LINE__);
-            exit(EXIT_FAILURE);
-        }
+        dpotrs_(&up, &n, &inc, M, &n, dy1, &n, &info);
 
         /* dX1 = -Zi*diag(dy1)*X - X */
         // NOTE: be carefull to multiply in column-major ordering!
@@ -178,9 +463,9 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         /* 1. step: tmp = -diag(dy1)*X */
         /* = multiply j-th row of X by -dy1[j]        (FORTRAN) */
         /* = multiply j-th column of X by -dy[j]      (C)       */
-        p3 = tmp; 
-        for (j = 0, p = X, p2 = dy1; j < nn; ++j, ++p, ++p3) {
-            *p3 = -(p2[j%n]) * (*p);
+        for (j = 0, p = X, p3 = tmp; j < n; ++j) {
+            for (k = 0; k < n; ++k, ++p, ++p3)
+                *p3 = -dy1[k] * (*p);
         }
 
         /* 2. step: Zi * tmp */
@@ -188,14 +473,10 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         beta = 0.0;
         dsymm_(&side,&up,&n,&n,&alpha,Zi,&n,tmp,&n,&beta,dX1,&n);
      
-        /* dX1 = dX1 - X */
-        alpha = -1.0;
-        daxpy_(&nn,&alpha,X,&inc,dX1,&inc);
-
-        /* symmetrize: dX1 = (dX1 + dX1')/2 */
+        /* symmetrize: dX1 = (dX1 + dX1')/2 - X */
         for (j = 0; j < n; ++j) {       
             for (k = 0; k <= j; ++k)    
-                dX1[k+n*j] = dX1[j+n*k] = 0.5 * (dX1[j+n*k] + dX1[k+n*j]);
+                dX1[k+n*j] = dX1[j+n*k] = 0.5 * ((dX1[j+n*k] - X[j+n*k]) + (dX1[k+n*j] - X[k+n*j]));
         }
 
   
@@ -203,52 +484,26 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         /******** diag(dy2)*X + Z*dX2 - mu*I + diag(dy1)*dX1 = 0 **/
 
         /* dy2 = M \ (mu*diag(Zi) - (Zi .* dX1)*dy1) */
-
-        /* dy = diag(Zi) */
-        diag(Zi,dy,n);     
-
-        /* tmp = Zi .* dX1 */
-        for (j = 0, p = tmp; j < nn; ++j, ++p)
-            *p = Zi[j] * dX1[j];
-
-        /* dy = -tmp*dy1 + mu*dy */
-        alpha = -1.0;
-        dsymv_(&up,&n,&alpha,tmp,&n,dy1,&inc,&mu,dy,&inc);
-
-        // NOTE: M was changed during dposv
-        /* M = Zi .* X */
-        for (j = 0, p = M; j < nn; ++j, ++p)
-            *p = Zi[j] * X[j];
-
-        /* dy2 = M \ dy */
         /* dy2 is saved in dy! */
-        dposv_(&up, &n, &inc, M, &n, dy, &n, &info);
-        if (info != 0) {
-            fprintf(stderr, "%s: corrector step: problem in solving linear system \
-                (line: %d).\n", __func__, __LINE__);
-            exit(EXIT_FAILURE);
+        for (j = 0; j < n; ++j)
+            dy[j] = mu * Zi[j+n*j];
+
+        for (j = 0, p = Zi, p2 = dX1; j < n; ++j) {
+            for (k = 0; k < n; ++k, ++p, ++p2)
+                dy[k] -= (*p) * (*p2) * dy1[j];
         }
 
+        dpotrs_(&up, &n, &inc, M, &n, dy, &n, &info);
+
         /* dX2 = mu*Zi - Zi*( diag(dy2) * X + diag(dy1) * dX1) */
 
-        /* 1. step: tmp = -diag(dy2)*X */
-        /* = multiply j-th row of X by -dy2[j]       (FORTRAN) */
-        /* = multiply j-th column of X by -dy2[j]    (C)       */    
+        /* tmp = -diag(dy2)*X - diag(dy1)*dX1 */
+        /* = multiply k-th row of X by -dy2[k] and of dX1 by -dy1[k] (FORTRAN) */
         /* NOTE: dy2 = dy */
-        p3 = tmp; 
-        for (j = 0, p = X, p2 = dy; j < nn; ++j, ++p, ++p3) {
-            *p3 = -(p2[j%n]) * (*p);
-        }
-
-        /* 2. step: tmp2 = -diag(dy1)*dX1 */
-        p3 = tmp2; 
-        for (j = 0, p = dX1, p2 = dy1; j < nn; ++j, ++p, ++p3) {
-            *p3 = -(p2[j%n]) * (*p);
+        for (j = 0, p = X, p2 = dX1, p3 = tmp; j < n; ++j) {
+            for (k = 0; k < n; ++k, ++p, ++p2, ++p3)
+                *p3 = -dy[k] * (*p) - dy1[k] * (*p2);
         }
-        
-        /* tmp = tmp + tmp2 */
-        alpha = 1.0;
-        daxpy_(&nn,&alpha,tmp2,&inc,tmp,&inc);
 
         /* dX2 = Zi * tmp*/
         /* NOTE: dX2 is stored in dX */
@@ -256,23 +511,17 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         beta = 0.0;
         dsymm_(&side,&up,&n,&n,&alpha,Zi,&n,tmp,&n,&beta,dX,&n);
         
-        /* dX = dX2 = mu*Zi + dX2 */
-        daxpy_(&nn,&mu,Zi,&inc,dX,&inc);
-
-      
         /**** final steps ****/
-        alpha = 1.0;
-        daxpy_(&n,&alpha,dy1,&inc,dy,&inc);     /* dy = dy1 + dy */
-        daxpy_(&nn,&alpha,dX1,&inc,dX,&inc);    /* dX = dX1 + dX */
-        
-        /* symmetrize: dX = (dX + dX')/2 */
+        /* dy = dy1 + dy */
+        for (j = 0; j < n; ++j)
+            dy[j] += dy1[j];
+
+        /* dX = dX1 + (dX2 + mu*Zi), symmetrized: dX = (dX + dX')/2 */
         for (j = 0; j < n; ++j) {       
             for (k = 0; k <= j; ++k)    
-                dX[k+n*j] = dX[j+n*k] = 0.5 * (dX[j+n*k] + dX[k+n*j]);
+                dX[k+n*j] = dX[j+n*k] = 0.5 * ((dX[j+n*k] + mu * Zi[j+n*k] + dX1[j+n*k]) + 
+                                               (dX[k+n*j] + mu * Zi[k+n*j] + dX1[k+n*j]));
         }
-
-        /* dZ = Diag(dy) */
-        Diag(dZ,dy,n);
                 
 
         /*********** find step lengths alpha_p and alpha_d ***********/
@@ -281,8 +530,11 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         alpha_p = 1.0;
         info = 1;
         while (info != 0) {
-            dcopy_(&nn,X,&inc,tmp,&inc);            /* tmp = X */
-            daxpy_(&nn,&alpha_p,dX,&inc,tmp,&inc);  /* tmp = alpha_p * dX + tmp */
+            /* tmp = alpha_p * dX + X (upper triangle) */
+            for (j = 0; j < n; ++j) {
+                for (k = 0; k <= j; ++k)
+                    tmp[k+n*j] = X[k+n*j] + alpha_p * dX[k+n*j];
+            }
             dpotrf_(&up,&n,tmp,&n,&info);
 
             if (info != 0)
@@ -293,18 +545,25 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
             alpha_p *= 0.95;
 
 
-        /* line search on dual */
+        /* line search on dual: Z = Z + alpha_d * Diag(dy) psd matrix */
         alpha_d = 1.0;
         info = 1;
         while (info != 0) {
-            dcopy_(&nn,Z,&inc,tmp,&inc);            /* tmp = Z */
-            daxpy_(&nn,&alpha_d,dZ,&inc,tmp,&inc);  /* tmp = alpha_d * dZ + tmp */
+            /* tmp = Z + alpha_d * Diag(dy) (upper triangle) */
+            for (j = 0; j < n; ++j) {
+                for (k = 0; k < j; ++k)
+                    tmp[k+n*j] = Z[k+n*j];
+                tmp[j+n*j] = Z[j+n*j] + alpha_d * dy[j];
+            }
             dpotrf_(&up,&n,tmp,&n,&info);
 
             if (info != 0)
                 alpha_d *= 0.8;
         }
         
+        /* tmp holds the Cholesky factor of the new Z for the next iteration */
+        factored = (alpha_d == 1.0);
+        
         if (alpha_d < 1.0)                          /* stay away from boundary */
             alpha_d *= 0.95;
 
@@ -312,7 +571,8 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         /******** update ********/
         daxpy_(&nn,&alpha_p,dX,&inc,X,&inc);        /* X = alpha_p * dX + X */    
         daxpy_(&n,&alpha_d,dy,&inc,y,&inc);         /* y = alpha_d * dy + y */
-        daxpy_(&nn,&alpha_d,dZ,&inc,Z,&inc);        /* Z = alpha_d * dZ + Z */
+        for (j = 0; j < n; ++j)                     /* Z = alpha_d * Diag(dy) + Z */
+            Z[j+n*j] += alpha_d * dy[j];
 
         /* mu = Z(:)'*X(:) / (2*n); */            
         mu = ddot_(&nn,Z,&inc,X,&inc) / (2.0 * n);   
@@ -338,22 +598,81 @@ void ipm_mc_pk(double *L, int n, double *X, double *phi, int print) {
         if (print)
             printf("%3d %11.2f %14.5f %14.5f \n",i,log10(gap),psi,*phi);
 
+        /* phi is an upper bound (Z is psd) and psi a lower bound on the optimal value */
+        if (*phi < prune_below) {
+            status = IPM_PRUNE;
+            break;
+        }
+        if (psi > keep_above && gap < IPM_KEEP_GAP) {
+            status = IPM_NO_PRUNE;
+            break;
+        }
+
     } // end of main loop
 
     if (print)
         puts("*******************************************");
 
-    /************* free memory *************/
-    free(y);
-    free(Z);
-    free(b);    
-    free(dX);
-    free(dy);
-    free(dZ);
-    free(Zi);
-    free(M);
-    free(dy1);
-    free(dX1);
-    free(tmp);
-    free(tmp2);
+    return status;
 }
+
+
+/*
+ * Solve the basic SDP relaxation of the subproblem PP with objective matrix L (of size PP->n)
+ * and store the solution as the starting point of the next call. If params.ipm_warm_start is set, 
+ * the solve starts from the last solution in the current node or from the final point of 
+ * the node being branched (ctx->parent) restricted to the rows of PP (if PP has no other rows).
+ * If params.ipm_early_stop is set, the solve stops as soon as phi < prune_below (node can be pruned)
+ * or the primal value exceeds keep_above (node cannot be pruned, a less accurate bound suffices).
+ * Returns the result of ipm_mc_pk.
+ */
+int ipm_solve(const BiqBinContext *ctx, double *L, double *X, double *phi, double prune_below, double keep_above) {
+
+    IPMPoint *cur = ctx->ipm_cur;
+    const IPMPoint *start = (cur->n > 0 || ctx->parent == NULL) ? cur : &ctx->parent->ipm;
+    int n = ctx->PP->n;
+    int nn = n * n;
+    int inc = 1;
+    int warm = 0;
+
+    if (ctx->tree->params.ipm_warm_start && start->n >= n) {
+
+        /* position of each row of PP in the stored point (both lists are increasing) */
+        int pos[n];
+        int k = 0;
+
+        warm = 1;
+        for (int i = 0; i < n && warm; ++i) {
+            while (k < start->n && start->vars[k] < ctx->PP_vars[i])
+                ++k;
+            if (k < start->n && start->vars[k] == ctx->PP_vars[i])
+                pos[i] = k;
+            else
+                warm = 0;
+        }
+
+        if (warm) {
+            for (int j = 0; j < n; ++j) {
+                for (int i = 0; i < n; ++i)
+                    X[i + j * n] = start->X[pos[i] + pos[j] * start->n];
+                cur->y[j] = start->y[pos[j]];
+            }
+        }
+    }
+
+    if (!ctx->tree->params.ipm_early_stop) {
+        prune_below = -BIG_NUMBER;
+        keep_above = BIG_NUMBER;
+    }
+
+    int status = ipm_mc_pk(ctx->ipm_ws, L, n, X, cur->y, phi, warm, prune_below, keep_above, 0);
+
+    if (ctx->tree->params.ipm_warm_start) {
+        dcopy_(&nn, X, &inc, cur->X, &inc);
+        memcpy(cur->vars, ctx->PP_vars, n * sizeof(int));
+        cur->n = n;
+    }
+
+    return status;
+}
+
@@ -1,11 +1,12 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "biqbin.h"  
 
                       
 int main(int argc, char **argv) {
-    if (argc != 3) {
-        fprintf(stderr, "Running main requires instance and paramaters arguments!\nUsage: ./biqbin file.rudy file.params\n");
+    if (argc != 3 && !(argc == 4 && strcmp(argv[3], "--resume") == 0)) {
+        fprintf(stderr, "Running main requires instance and paramaters arguments!\nUsage: ./biqbin file.rudy file.params [--resume]\n");
         exit(1);
     }
     MaxCutInputData *inputData = (MaxCutInputData *)malloc(sizeof(MaxCutInputData));
@@ -14,7 +15,10 @@ int main(int argc, char **argv) {
     params_local = readParameters(argv[2]); // read params file, get BiqBinParameters structure
     inputData = readGraphFile(argv[1], inputData); // read graph file, get MaxCutInputData structure
 
-    compute(inputData, params_local); // Compute with the input data and parameters passed as args
+    if (argc == 4)
+        compute_resume(inputData, params_local); // Continue from the checkpoint of the instance
+    else
+        compute(inputData, params_local); // Compute with the input data and parameters passed as args
 
     free(inputData);
     exit(0);
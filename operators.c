@@ -2,10 +2,6 @@
 
 #include "biqbin.h"
 
-extern Triangle_Inequality *Cuts;           // vector of triangle inequality constraints
-extern Pentagonal_Inequality *Pent_Cuts;    // vector of pentagonal inequality constraints
-extern Heptagonal_Inequality *Hepta_Cuts;   // vector of heptagonal inequality constraints
-
 
 /***************** diag *********************/
 /* 
@@ -43,92 +39,271 @@ void Diag(double *X, const double *y, int n) {
  *  Similarly for heptagonal inequalities: -1/3(X(hept,hept) without diagonal termn) <= 1!! 
 ***/
 
+/***************** cut operator *********************/
+/*
+ * Cuts are compiled into a sparse operator, one block per family (triangle, pentagonal,
+ * heptagonal). A cut on vertices p[0..w-1] with sign vector h of its type is
+ *
+ *     B(X) = scale * sum_{a < b} coef_ab * X[p_a, p_b],   coef_ab = -h_a * h_b,
+ *
+ * with one entry per pair (a,b). Entries are stored entry-major (entry e of cut c at
+ * e * cap + c): linear index into X, index of the transposed element and coefficient.
+ * The kernels then run over the cuts of a family in straight loops that the compiler
+ * can vectorize, and they add the terms of a cut in the same order as the explicit
+ * formulas they replace, so results are the same to the last bit.
+ */
+
+/* sign vectors h of the cut types (type t uses row t-1) */
+static const int H_tri[4][3] = { { 1,  1,  1},
+                                 { 1,  1, -1},
+                                 { 1, -1,  1},
+                                 {-1,  1,  1} };
+
+static const int H_pent[3][5] = { { 1,  1, 1, 1, 1},        // H1 = ee^T
+                                  {-1,  1, 1, 1, 1},        // e[0] = -1
+                                  {-1, -1, 1, 1, 1} };      // e[0] = -1, e[1] = -1
+
+static const int H_hepta[4][7] = { { 1,  1,  1, 1, 1, 1, 1},    // H1 = ee^T
+                                   {-1,  1,  1, 1, 1, 1, 1},    // e[0] = -1
+                                   {-1, -1,  1, 1, 1, 1, 1},    // e[0] = -1, e[1] = -1
+                                   {-1, -1, -1, 1, 1, 1, 1} };  // e[0] = -1, e[1] = -1, e[2] = -1
+
+
+/* compile cut c of family F on vertices p with sign vector h (w vertices) */
+static void compile_cut(CutFamily *F, int c, int N, const int *p, const int *h, int w) {
+
+    int e = 0;
+
+    for (int a = 0; a < w; ++a) {
+        for (int b = a + 1; b < w; ++b, ++e) {
+            F->idx[e * F->cap + c]  = p[a] + p[b] * N;
+            F->idxT[e * F->cap + c] = p[b] + p[a] * N;
+            F->coef[e * F->cap + c] = -h[a] * h[b];
+        }
+    }
+}
+
+
+/* move compiled cut from position from to position to */
+static void move_cut(CutFamily *F, int from, int to) {
+
+    for (int e = 0; e < F->width; ++e) {
+        F->idx[e * F->cap + to]  = F->idx[e * F->cap + from];
+        F->idxT[e * F->cap + to] = F->idxT[e * F->cap + from];
+        F->coef[e * F->cap + to] = F->coef[e * F->cap + from];
+    }
+}
+
+
+/*
+ * Bring the cut operator up to date after separation: kept cuts are moved to their new
+ * position (row in G before separation, see SDPbound), only new cuts are compiled.
+ * Within a family kept cuts only move to lower positions, so this works in place.
+ */
+void CutOp_Update(BiqBinContext *ctx) {
+
+    const Problem *P = ctx->PP;
+    CutOperator *op = ctx->cut_op;
+    int N = P->n;
+    int first[3] = {0, op->fam[0].m, op->fam[0].m + op->fam[1].m};   // first row of the families before separation
+    int row, p[3];
+
+    CutFamily *F = &op->fam[0];
+    for (int c = 0; c < P->NIneq; ++c) {
+        row = ctx->Cuts[c].row;
+        if (row >= 0) {
+            if (row - first[0] != c)
+                move_cut(F, row - first[0], c);
+        }
+        else {
+            p[0] = ctx->Cuts[c].i;
+            p[1] = ctx->Cuts[c].j;
+            p[2] = ctx->Cuts[c].k;
+            compile_cut(F, c, N, p, H_tri[ctx->Cuts[c].type - 1], 3);
+        }
+    }
+    F->m = P->NIneq;
+
+    F = &op->fam[1];
+    for (int c = 0; c < P->NPentIneq; ++c) {
+        row = ctx->Pent_Cuts[c].row;
+        if (row >= 0) {
+            if (row - first[1] != c)
+                move_cut(F, row - first[1], c);
+        }
+        else
+            compile_cut(F, c, N, ctx->Pent_Cuts[c].permutation, H_pent[ctx->Pent_Cuts[c].type - 1], 5);
+    }
+    F->m = P->NPentIneq;
+
+    F = &op->fam[2];
+    for (int c = 0; c < P->NHeptaIneq; ++c) {
+        row = ctx->Hepta_Cuts[c].row;
+        if (row >= 0) {
+            if (row - first[2] != c)
+                move_cut(F, row - first[2], c);
+        }
+        else
+            compile_cut(F, c, N, ctx->Hepta_Cuts[c].permutation, H_hepta[ctx->Hepta_Cuts[c].type - 1], 7);
+    }
+    F->m = P->NHeptaIneq;
+}
+
+
+/*
+ * Value B(X) - 1 of a cut of family (0 triangle, 1 pentagonal, 2 heptagonal) and type on
+ * vertices p; the cut is violated by X if the value is positive.
+ */
+double evaluateCut(const double *X, int N, int family, int type, const int *p) {
+
+    static const int width[3] = {3, 5, 7};
+    static const double scale[3] = {1.0, 0.5, 1.0/3.0};
+    const int *h = (family == 0) ? H_tri[type - 1] : (family == 1) ? H_pent[type - 1] : H_hepta[type - 1];
+    int w = width[family];
+    double sum = 0.0;
+
+    for (int a = 0; a < w; ++a)
+        for (int b = a + 1; b < w; ++b)
+            sum -= h[a] * h[b] * X[p[a] + p[b] * N];
+
+    return scale[family] * sum - 1.0;
+}
+
+
+/*
+ * Key of a cut of family and type on vertices p that does not depend on the order of the
+ * vertices with equal sign in h (all these orders give the same inequality): the number of
+ * vertices with sign -1, then these vertices and the vertices with sign +1, both sorted.
+ * The key has width + 1 entries.
+ */
+void cutKey(int family, int type, const int *p, int *key) {
+
+    static const int width[3] = {3, 5, 7};
+    const int *h = (family == 0) ? H_tri[type - 1] : (family == 1) ? H_pent[type - 1] : H_hepta[type - 1];
+    int w = width[family];
+    int neg = 0;
+
+    for (int a = 0; a < w; ++a)
+        neg += (h[a] < 0);
+
+    key[0] = neg;
+
+    // insertion sort of each sign class into its part of the key
+    int count[2] = {0, 0};
+    for (int a = 0; a < w; ++a) {
+        int c = (h[a] > 0);
+        int *part = key + 1 + (c ? neg : 0);
+        int b = count[c]++;
+        while (b > 0 && part[b - 1] > p[a]) {
+            part[b] = part[b - 1];
+            --b;
+        }
+        part[b] = p[a];
+    }
+}
+
+
 /***************** op_B *********************/
 /*
  * computes y = y - B(X), where operator B
  * corresponds to cutting planes: triangle, pentagonal and heptagonal inequalities
  */
-void op_B(const Problem *P, double *y, const double *X) {
+void op_B(const BiqBinContext *ctx, double *y, const double *X) {
 
-    int N = P->n;
-    int type, ii, jj, kk, ll, mm, nn, oo;
+    const CutOperator *op = ctx->cut_op;
+    double *sum = op->sum;
     
-    /* triangle inequalities */
-    for (int ineq = 0; ineq < P->NIneq; ++ineq) {
-
-        type = Cuts[ineq].type;
-        ii   = Cuts[ineq].i;
-        jj   = Cuts[ineq].j;
-        kk   = Cuts[ineq].k;
-
-        switch (type) {
-            
-            case 1:
-                y[ineq] -= (-X[ii + jj * N] - X[ii + kk * N] - X[jj + kk * N]);
-                break;
-            case 2:
-                y[ineq] -= (-X[ii + jj * N] + X[ii + kk * N] + X[jj + kk * N]);
-                break;
-            case 3:
-                y[ineq] -= (X[ii + jj * N] - X[ii + kk * N] + X[jj + kk * N]);
-                break;
-            default: //type == 4
-                y[ineq] -= (X[ii + jj * N] + X[ii + kk * N] - X[jj + kk * N]);
-        }
-    }    
+    for (int f = 0; f < 3; ++f) {
+
+        const CutFamily *F = &op->fam[f];
+        int m = F->m;
+
+        for (int c = 0; c < m; ++c)
+            sum[c] = 0.0;
 
-    /* pentagonal inequalities */
-    for (int ineq = 0; ineq < P->NPentIneq; ++ineq) {
-
-        type = Pent_Cuts[ineq].type;
-        ii   = Pent_Cuts[ineq].permutation[0];
-        jj   = Pent_Cuts[ineq].permutation[1];
-        kk   = Pent_Cuts[ineq].permutation[2];
-        ll   = Pent_Cuts[ineq].permutation[3];
-        mm   = Pent_Cuts[ineq].permutation[4];
-
-        switch (type) {
-
-            case 1: // H1 = ee^T, where e is vector of all ones 
-                y[P->NIneq + ineq] -= 0.5 * (-X[ii + jj * N] - X[ii + kk * N] - X[ii + ll * N] - X[ii + mm * N] - X[jj + kk * N] - X[jj + ll * N] - X[jj + mm * N] - X[kk + ll * N] - X[kk + mm * N] - X[ll + mm * N] );
-                break;
-            case 2: // e[0] = -1; H2 = ee^T
-                y[P->NIneq + ineq] -= 0.5 * (X[ii + jj * N] + X[ii + kk * N] + X[ii + ll * N] + X[ii + mm * N] - X[jj + kk * N] - X[jj + ll * N] - X[jj + mm * N] - X[kk + ll * N] - X[kk + mm * N] - X[ll + mm * N] );
-                break;
-            default: // type = 3; // e[0] = -1, e[1] = -1; H3 = ee^T
-                y[P->NIneq + ineq] -= 0.5 * (-X[ii + jj * N] + X[ii + kk * N] + X[ii + ll * N] + X[ii + mm * N] + X[jj + kk * N] + X[jj + ll * N] + X[jj + mm * N] - X[kk + ll * N] - X[kk + mm * N] - X[ll + mm * N] );                    
+        for (int e = 0; e < F->width; ++e) {
+            const int *idx = F->idx + e * F->cap;
+            const double *coef = F->coef + e * F->cap;
+            for (int c = 0; c < m; ++c)
+                sum[c] += coef[c] * X[idx[c]];
         }
 
+        for (int c = 0; c < m; ++c)
+            y[c] -= F->scale * sum[c];
+
+        y += m;
     }
+}
+
+
+/* cut c of family f was added by the last separation */
+static int new_cut(const BiqBinContext *ctx, int f, int c) {
+    int row = (f == 0) ? ctx->Cuts[c].row : (f == 1) ? ctx->Pent_Cuts[c].row : ctx->Hepta_Cuts[c].row;
+    return row < 0;
+}
 
-    /* heptagonal inequalities */
-    for (int ineq = 0; ineq < P->NHeptaIneq; ++ineq) {
-
-        type = Hepta_Cuts[ineq].type;
-        ii   = Hepta_Cuts[ineq].permutation[0];
-        jj   = Hepta_Cuts[ineq].permutation[1];
-        kk   = Hepta_Cuts[ineq].permutation[2];
-        ll   = Hepta_Cuts[ineq].permutation[3];
-        mm   = Hepta_Cuts[ineq].permutation[4]; 
-        nn   = Hepta_Cuts[ineq].permutation[5];
-        oo   = Hepta_Cuts[ineq].permutation[6];   
-
-        switch (type) {
-
-            case 1: // H1 = ee^T, where e is vector of all ones 
-                y[P->NIneq + P->NPentIneq + ineq] -= 1.0/3.0 * (-X[ii + jj * N] - X[ii + kk * N] - X[ii + ll * N] - X[ii + mm * N] - X[ii + nn * N] - X[ii + oo * N] - X[jj + kk * N] - X[jj + ll * N] - X[jj + mm * N] - X [jj + nn * N] - X[jj + oo * N] - X[kk + ll * N] - X[kk + mm * N] - X[kk + nn * N] - X[kk + oo * N] - X[ll + mm * N] - X[ll + nn * N] - X[ll + oo * N] - X[mm + nn * N] - X[mm + oo * N] - X[nn + oo * N]);
-                break;
-            case 2: // e[0] = -1; H2 = ee^T
-                y[P->NIneq + P->NPentIneq + ineq] -= 1.0/3.0 * (X[ii + jj * N] + X[ii + kk * N] + X[ii + ll * N] + X[ii + mm * N] + X[ii + nn * N] + X[ii + oo * N] - X[jj + kk * N] - X[jj + ll * N] - X[jj + mm * N] - X[jj + nn * N] - X[jj + oo * N] - X[kk + ll * N] - X[kk + mm * N] - X[kk + nn * N] - X[kk + oo * N] - X[ll + mm * N] - X[ll + nn * N] - X[ll + oo * N] - X[mm + nn * N] - X[mm + oo * N] - X[nn + oo * N]);
-                break;    
-            case 3: // H1 = ee^T, where e is vector of all ones 
-                y[P->NIneq + P->NPentIneq + ineq] -= 1.0/3.0 * (-X[ii + jj * N] + X[ii + kk * N] + X[ii + ll * N] + X[ii + mm * N] + X[ii + nn * N] + X[ii + oo * N] + X[jj + kk * N] + X[jj + ll * N] + X[jj + mm * N] + X[jj + nn * N] + X[jj + oo * N] - X[kk + ll * N] - X[kk + mm * N] - X[kk + nn * N] - X[kk + oo * N] - X[ll + mm * N] - X[ll + nn * N] - X[ll + oo * N] - X[mm + nn * N] - X[mm + oo * N] - X[nn + oo * N]);
-                break;   
-            default: // e[0] = -1, e[1] = -1, e[2] = -1; H4 = ee^T
-                y[P->NIneq + P->NPentIneq + ineq] -= 1.0/3.0 * (-X[ii + jj * N] - X[ii + kk * N] + X[ii + ll * N] + X[ii + mm * N] + X[ii + nn * N] + X[ii + oo * N] - X[jj + kk * N] + X[jj + ll * N] + X[jj + mm * N] + X [jj + nn * N] + X[jj + oo * N] + X[kk + ll * N] + X[kk + mm * N] + X[kk + nn * N] + X[kk + oo * N] - X[ll + mm * N] - X[ll + nn * N] - X[ll + oo * N] - X[mm + nn * N] - X[mm + oo * N] - X[nn + oo * N]);   
-        }  
+
+/*
+ * Rows of the cuts added by the last separation for the k bundle matrices X_i in packed form
+ * (see bundle.c): G[r + i * ldg] -= B(X_i)[r] for every new cut r, other rows are not changed.
+ * New cuts are taken in blocks of CUT_BLOCK. Packed offsets of a block are computed once
+ * and the block is applied to all k matrices, so the cut list is read once (not once per
+ * matrix) and the matrices are read in packed form without unpacking them.
+ */
+#define CUT_BLOCK 64
+
+void op_B_bundle(const BiqBinContext *ctx, double *const *X_bundle, int k, double *G, int ldg) {
+
+    const CutOperator *op = ctx->cut_op;
+    int n = ctx->PP->n;
+    int cut[CUT_BLOCK];                 // position of the cuts of the block in their family
+    int pos[21 * CUT_BLOCK];            // packed offsets of the entries (entry e of cut b at e * CUT_BLOCK + b)
+    double coef[21 * CUT_BLOCK];
+    double sum[CUT_BLOCK];
+    int first = 0;                      // first row of the family
+
+    for (int f = 0; f < 3; ++f) {
+
+        const CutFamily *F = &op->fam[f];
+        int nb = 0;
+
+        for (int c = 0; c <= F->m; ++c) {
+
+            if (c < F->m && new_cut(ctx, f, c)) {
+                cut[nb] = c;
+                for (int e = 0; e < F->width; ++e) {
+                    int a = F->idx[e * F->cap + c] % n;
+                    int b = F->idx[e * F->cap + c] / n;
+                    int lo = (a < b) ? a : b;
+                    int hi = (a < b) ? b : a;
+                    pos[e * CUT_BLOCK + nb] = hi * (hi + 1) / 2 + lo;
+                    coef[e * CUT_BLOCK + nb] = F->coef[e * F->cap + c];
+                }
+                ++nb;
+            }
+
+            if (nb == CUT_BLOCK || (c == F->m && nb > 0)) {
+                for (int i = 0; i < k; ++i) {
+
+                    const double *X = X_bundle[i];
+                    double *y = G + (size_t) i * ldg + first;
+
+                    for (int b = 0; b < nb; ++b)
+                        sum[b] = 0.0;
+
+                    for (int e = 0; e < F->width; ++e)
+                        for (int b = 0; b < nb; ++b)
+                            sum[b] += coef[e * CUT_BLOCK + b] * X[pos[e * CUT_BLOCK + b]];
+
+                    for (int b = 0; b < nb; ++b)
+                        y[cut[b]] -= F->scale * sum[b];
+                }
+                nb = 0;
+            }
+        }
+
+        first += F->m;
     }
-              
 }
 
 
@@ -136,346 +311,26 @@ void op_B(const Problem *P, double *y, const double *X) {
 /*
  * computes X = X - Bt(t), where operator B
  * corresponds to cutting planes: triangle, pentagonal and heptagonal inequalities
+ * (Bt(t) adds half of each coefficient to X[p_a, p_b] and X[p_b, p_a])
  */
-void op_Bt(const Problem *P, double *X, const double *tt) {
+void op_Bt(const BiqBinContext *ctx, double *X, const double *tt) {
 
-    int N = P->n;
-    int type, ii, jj, kk, ll, mm, nn, oo;
-    double temp;
-
-    /***** triangle inequalities *****/ 
-    for (int ineq = 0; ineq < P->NIneq; ++ineq) {
-
-        type = Cuts[ineq].type;
-        ii   = Cuts[ineq].i;
-        jj   = Cuts[ineq].j;
-        kk   = Cuts[ineq].k;
-
-        temp = 0.5 * tt[ineq];
-
-        switch (type) {
-            
-            case 1:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] += temp; 
-                X[jj + kk * N] += temp; 
-                X[jj + ii * N] += temp;
-                X[kk + ii * N] += temp;
-                X[kk + jj * N] += temp;
-                break;
-            case 2:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] -= temp; 
-                X[jj + kk * N] -= temp; 
-                X[jj + ii * N] += temp;
-                X[kk + ii * N] -= temp;
-                X[kk + jj * N] -= temp;
-                break;
-            case 3:
-                X[ii + jj * N] -= temp; 
-                X[ii + kk * N] += temp; 
-                X[jj + kk * N] -= temp; 
-                X[jj + ii * N] -= temp;
-                X[kk + ii * N] += temp;
-                X[kk + jj * N] -= temp;
-                break;
-            default: //type == 4
-                X[ii + jj * N] -= temp; 
-                X[ii + kk * N] -= temp; 
-                X[jj + kk * N] += temp; 
-                X[jj + ii * N] -= temp;
-                X[kk + ii * N] -= temp;
-                X[kk + jj * N] += temp;
-        }
-    }
+    const CutOperator *op = ctx->cut_op;
 
-    /***** pentagonal inequalities *****/
-    for (int ineq = 0; ineq < P->NPentIneq; ++ineq) {
-
-        type = Pent_Cuts[ineq].type;
-        ii   = Pent_Cuts[ineq].permutation[0];
-        jj   = Pent_Cuts[ineq].permutation[1];
-        kk   = Pent_Cuts[ineq].permutation[2];
-        ll   = Pent_Cuts[ineq].permutation[3];
-        mm   = Pent_Cuts[ineq].permutation[4];
-
-        temp = 0.25 * tt[P->NIneq + ineq]; // 0.5 due to symmetry and 0.5 due to pentagonal inequality -0.5*(...) <= 1 
-
-        switch (type) {
-            case 1:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] += temp; 
-                X[ii + ll * N] += temp;
-                X[ii + mm * N] += temp;
-                X[jj + kk * N] += temp;
-                X[jj + ll * N] += temp;
-                X[jj + mm * N] += temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[ll + mm * N] += temp;
-
-                X[jj + ii * N] += temp; 
-                X[kk + ii * N] += temp; 
-                X[ll + ii * N] += temp;
-                X[mm + ii * N] += temp;
-                X[kk + jj * N] += temp;
-                X[ll + jj * N] += temp;
-                X[mm + jj * N] += temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                break;
-
-            case 2:
-                X[ii + jj * N] -= temp; 
-                X[ii + kk * N] -= temp; 
-                X[ii + ll * N] -= temp;
-                X[ii + mm * N] -= temp;
-                X[jj + kk * N] += temp;
-                X[jj + ll * N] += temp;
-                X[jj + mm * N] += temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[ll + mm * N] += temp;
-
-                X[jj + ii * N] -= temp; 
-                X[kk + ii * N] -= temp; 
-                X[ll + ii * N] -= temp;
-                X[mm + ii * N] -= temp;
-                X[kk + jj * N] += temp;
-                X[ll + jj * N] += temp;
-                X[mm + jj * N] += temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                break;    
-
-            case 3:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] -= temp; 
-                X[ii + ll * N] -= temp;
-                X[ii + mm * N] -= temp;
-                X[jj + kk * N] -= temp;
-                X[jj + ll * N] -= temp;
-                X[jj + mm * N] -= temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[ll + mm * N] += temp;
-
-                X[jj + ii * N] += temp; 
-                X[kk + ii * N] -= temp; 
-                X[ll + ii * N] -= temp;
-                X[mm + ii * N] -= temp;
-                X[kk + jj * N] -= temp;
-                X[ll + jj * N] -= temp;
-                X[mm + jj * N] -= temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                break;    
-        }
+    for (int f = 0; f < 3; ++f) {
 
-    }    
+        const CutFamily *F = &op->fam[f];
+
+        // cuts can share entries of X, so the scatter runs cut by cut
+        for (int c = 0; c < F->m; ++c) {
+            double temp = F->half * tt[c];
+            for (int e = 0; e < F->width; ++e) {
+                double v = -F->coef[e * F->cap + c] * temp;
+                X[F->idx[e * F->cap + c]]  += v;
+                X[F->idxT[e * F->cap + c]] += v;
+            }
+        }
 
-    /***** heptagonal inequalities *****/
-    for (int ineq = 0; ineq < P->NHeptaIneq; ++ineq) {
-
-        type = Hepta_Cuts[ineq].type;
-        ii   = Hepta_Cuts[ineq].permutation[0];
-        jj   = Hepta_Cuts[ineq].permutation[1];
-        kk   = Hepta_Cuts[ineq].permutation[2];
-        ll   = Hepta_Cuts[ineq].permutation[3];
-        mm   = Hepta_Cuts[ineq].permutation[4]; 
-        nn   = Hepta_Cuts[ineq].permutation[5];
-        oo   = Hepta_Cuts[ineq].permutation[6];
-
-        temp = 1.0/6.0 * tt[P->NIneq + P->NPentIneq + ineq]; // 0.5 due to symmetry and 1/3 due to heptagonal inequality -1/3*(...) <= 1 
-
-        switch (type) {
-            case 1:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] += temp; 
-                X[ii + ll * N] += temp;
-                X[ii + mm * N] += temp;
-                X[ii + nn * N] += temp;
-                X[ii + oo * N] += temp;
-                X[jj + kk * N] += temp;
-                X[jj + ll * N] += temp;
-                X[jj + mm * N] += temp;
-                X[jj + nn * N] += temp;
-                X[jj + oo * N] += temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[kk + nn * N] += temp;
-                X[kk + oo * N] += temp;
-                X[ll + mm * N] += temp;
-                X[ll + nn * N] += temp;
-                X[ll + oo * N] += temp;
-                X[mm + nn * N] += temp;
-                X[mm + oo * N] += temp;
-                X[nn + oo * N] += temp;
-
-                X[jj + ii * N] += temp; 
-                X[kk + ii * N] += temp; 
-                X[ll + ii * N] += temp;
-                X[mm + ii * N] += temp;
-                X[nn + ii * N] += temp;
-                X[oo + ii * N] += temp;
-                X[kk + jj * N] += temp;
-                X[ll + jj * N] += temp;
-                X[mm + jj * N] += temp;
-                X[nn + jj * N] += temp;
-                X[oo + jj * N] += temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[nn + kk * N] += temp;
-                X[oo + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                X[nn + ll * N] += temp;
-                X[oo + ll * N] += temp;
-                X[nn + mm * N] += temp;
-                X[oo + mm * N] += temp;
-                X[oo + nn * N] += temp;
-                break;
-
-            case 2:
-                X[ii + jj * N] -= temp; 
-                X[ii + kk * N] -= temp; 
-                X[ii + ll * N] -= temp;
-                X[ii + mm * N] -= temp;
-                X[ii + nn * N] -= temp;
-                X[ii + oo * N] -= temp;
-                X[jj + kk * N] += temp;
-                X[jj + ll * N] += temp;
-                X[jj + mm * N] += temp;
-                X[jj + nn * N] += temp;
-                X[jj + oo * N] += temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[kk + nn * N] += temp;
-                X[kk + oo * N] += temp;
-                X[ll + mm * N] += temp;
-                X[ll + nn * N] += temp;
-                X[ll + oo * N] += temp;
-                X[mm + nn * N] += temp;
-                X[mm + oo * N] += temp;
-                X[nn + oo * N] += temp;
-
-                X[jj + ii * N] -= temp; 
-                X[kk + ii * N] -= temp; 
-                X[ll + ii * N] -= temp;
-                X[mm + ii * N] -= temp;
-                X[nn + ii * N] -= temp;
-                X[oo + ii * N] -= temp;
-                X[kk + jj * N] += temp;
-                X[ll + jj * N] += temp;
-                X[mm + jj * N] += temp;
-                X[nn + jj * N] += temp;
-                X[oo + jj * N] += temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[nn + kk * N] += temp;
-                X[oo + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                X[nn + ll * N] += temp;
-                X[oo + ll * N] += temp;
-                X[nn + mm * N] += temp;
-                X[oo + mm * N] += temp;
-                X[oo + nn * N] += temp;
-                break;  
-
-            case 3:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] -= temp; 
-                X[ii + ll * N] -= temp;
-                X[ii + mm * N] -= temp;
-                X[ii + nn * N] -= temp;
-                X[ii + oo * N] -= temp;
-                X[jj + kk * N] -= temp;
-                X[jj + ll * N] -= temp;
-                X[jj + mm * N] -= temp;
-                X[jj + nn * N] -= temp;
-                X[jj + oo * N] -= temp;
-                X[kk + ll * N] += temp;
-                X[kk + mm * N] += temp;
-                X[kk + nn * N] += temp;
-                X[kk + oo * N] += temp;
-                X[ll + mm * N] += temp;
-                X[ll + nn * N] += temp;
-                X[ll + oo * N] += temp;
-                X[mm + nn * N] += temp;
-                X[mm + oo * N] += temp;
-                X[nn + oo * N] += temp;
-
-                X[jj + ii * N] += temp; 
-                X[kk + ii * N] -= temp; 
-                X[ll + ii * N] -= temp;
-                X[mm + ii * N] -= temp;
-                X[nn + ii * N] -= temp;
-                X[oo + ii * N] -= temp;
-                X[kk + jj * N] -= temp;
-                X[ll + jj * N] -= temp;
-                X[mm + jj * N] -= temp;
-                X[nn + jj * N] -= temp;
-                X[oo + jj * N] -= temp;
-                X[ll + kk * N] += temp;
-                X[mm + kk * N] += temp;
-                X[nn + kk * N] += temp;
-                X[oo + kk * N] += temp;
-                X[mm + ll * N] += temp;
-                X[nn + ll * N] += temp;
-                X[oo + ll * N] += temp;
-                X[nn + mm * N] += temp;
-                X[oo + mm * N] += temp;
-                X[oo + nn * N] += temp;
-                break;      
-
-            case 4:
-                X[ii + jj * N] += temp; 
-                X[ii + kk * N] += temp; 
-                X[ii + ll * N] -= temp;
-                X[ii + mm * N] -= temp;
-                X[ii + nn * N] -= temp;
-                X[ii + oo * N] -= temp;
-                X[jj + kk * N] += temp;
-                X[jj + ll * N] -= temp;
-                X[jj + mm * N] -= temp;
-                X[jj + nn * N] -= temp;
-                X[jj + oo * N] -= temp;
-                X[kk + ll * N] -= temp;
-                X[kk + mm * N] -= temp;
-                X[kk + nn * N] -= temp;
-                X[kk + oo * N] -= temp;
-                X[ll + mm * N] += temp;
-                X[ll + nn * N] += temp;
-                X[ll + oo * N] += temp;
-                X[mm + nn * N] += temp;
-                X[mm + oo * N] += temp;
-                X[nn + oo * N] += temp;
-
-                X[jj + ii * N] += temp; 
-                X[kk + ii * N] += temp; 
-                X[ll + ii * N] -= temp;
-                X[mm + ii * N] -= temp;
-                X[nn + ii * N] -= temp;
-                X[oo + ii * N] -= temp;
-                X[kk + jj * N] += temp;
-                X[ll + jj * N] -= temp;
-                X[mm + jj * N] -= temp;
-                X[nn + jj * N] -= temp;
-                X[oo + jj * N] -= temp;
-                X[ll + kk * N] -= temp;
-                X[mm + kk * N] -= temp;
-                X[nn + kk * N] -= temp;
-                X[oo + kk * N] -= temp;
-                X[mm + ll * N] += temp;
-                X[nn + ll * N] += temp;
-                X[oo + ll * N] += temp;
-                X[nn + mm * N] += temp;
-                X[oo + mm * N] += temp;
-                X[oo + nn * N] += temp;
-                break;    
-
-        }        
+        tt += F->m;
     }    
 }
@@ -5,12 +5,6 @@
 
 #include "biqbin.h"
 
-extern FILE *output;
-extern Problem *SP;
-extern Problem *PP;
-extern BiqBinParameters params; // global parameters :(
-extern int BabPbSize;
-
 // macro to handle the errors in the input reading
 #define READING_ERROR(file,cond,message)\
         if ((cond)) {\
@@ -54,7 +48,7 @@ void printMatrixSum(double *Mat, int N) {
     printf("Sum of matrix = %f\n", sum);
 }
 
-void openOutputFile(const char *name) {
+void openOutputFile(BiqBinContext *ctx, const char *name) {
     // Create the output file
     char output_path[200];
     sprintf(output_path, "%s.output", name);
@@ -66,8 +60,8 @@ void openOutputFile(const char *name) {
     while (stat(output_path, &buffer) == 0)
         sprintf(output_path, "%s.output_%d", name, counter++);
 
-    output = fopen(output_path, "w");
-    if (!output) {
+    ctx->tree->output = fopen(output_path, "w");
+    if (!ctx->tree->output) {
         fprintf(stderr, "Error: Cannot create output file.\n");
         exit(1);
     }
@@ -110,29 +104,27 @@ BiqBinParameters readParameters(const char *path) {
     return params_local;
 }
 
-void setParams(BiqBinParameters params_in) {
-    params = params_in;
+void setParams(BiqBinContext *ctx, BiqBinParameters params_in) {
+    ctx->tree->params = params_in;
 }
 
 void printParameters(BiqBinParameters params_in) {
-    printf("BiqBin parameters:\n");
+    writeParameters(stdout, params_in);
+}
+
+/* write the parameters to file (e.g. the output file of a solve) */
+void writeParameters(FILE *file, BiqBinParameters params_in) {
+    fprintf(file, "BiqBin parameters:\n");
     #define P(type, name, format, def_value) \
-        printf("%20s = " format "\n", #name, params_in.name);
+        fprintf(file, "%20s = " format "\n", #name, params_in.name);
 
     PARAM_FIELDS
     #undef P
-
-    if (output) {
-        fprintf(output, "BiqBin parameters:\n");
-        #define P(type, name, format, def_value) \
-        fprintf(output ? output : stdout, "%20s = " format "\n", #name, params_in.name);
-
-        PARAM_FIELDS
-        #undef P
-    }
 }
 
-void printHeader(MaxCutInputData *input_data) {
+void printHeader(const BiqBinContext *ctx, MaxCutInputData *input_data) {
+    FILE *output = ctx->tree->output;
+
     printf("Input file: %s\n", input_data->name);
     printf("\nGraph has %d vertices and %d edges.\n\n", input_data->num_vertices, input_data->num_edges);
 
@@ -142,6 +134,27 @@ void printHeader(MaxCutInputData *input_data) {
     }
 }
 
+/* print estimated memory of the solve (before B&B starts) */
+void printMemoryEstimate(const BiqBinContext *ctx, int num_workers) {
+    FILE *output = ctx->tree->output;
+
+    const double MB = 1024.0 * 1024.0;
+    size_t nn = (size_t) ctx->tree->SP->n * ctx->tree->SP->n;
+    size_t workspace = workspaceMemory(ctx);
+    size_t node_size = sizeof(BabNode) + 2 * BAB_WORDS(ctx->tree->BabPbSize) * sizeof(uint64_t);
+
+    // SP->L, bounding workspaces of all workers and the cut pool (nodes are allocated during the solve)
+    size_t total = nn * sizeof(double) + num_workers * workspace + CutPool_Memory(&ctx->tree->params);
+
+    printf("Estimated memory = %.1f MB (bounding workspace %.1f MB per worker, %d worker(s), %zu bytes per B&B node)\n\n", 
+           total / MB, workspace / MB, num_workers, node_size);
+
+    if (output) {
+        fprintf(output, "Estimated memory = %.1f MB (bounding workspace %.1f MB per worker, %d worker(s), %zu bytes per B&B node)\n\n", 
+                total / MB, workspace / MB, num_workers, node_size);
+    }
+}
+
 void printInputData(MaxCutInputData *input_data) {
     printf("Input data: %s\n", input_data->name);
     printf("Number of vertices: %d\n", input_data->num_vertices);
@@ -179,28 +192,29 @@ void printProblem(const Problem *p) {
 
 /// @brief Essential before compute! Read input data and construct and set the matrices SP->L and PP->L.
 /// @param input_data 
-void processAdjMatrixSetPP_SP(MaxCutInputData *input_data) {
+void processAdjMatrixSetPP_SP(BiqBinContext *ctx, MaxCutInputData *input_data) {
     int num_vertices = input_data->num_vertices;
+    Problem *SP;
 
     // Need to copy the Adj matrix because alloc_matrix(SO->L) resets it? Not sure why, only a problem when it is ran through Python.
-    double *Adj = (double *) malloc(num_vertices * num_vertices * sizeof(double));
-    memcpy(Adj, input_data->Adj, num_vertices * num_vertices * sizeof(double));
+    size_t Adj_size = (size_t) num_vertices * num_vertices * sizeof(double);
+    double *Adj = (double *) malloc(Adj_size);
+    memcpy(Adj, input_data->Adj, Adj_size);
 
-    // allocate memory for original problem SP and subproblem PP
+    // allocate memory for original problem SP
+    // NOTE: subproblem PP is part of the bounding workspace (allocMemory)
     alloc(SP, Problem);
-    alloc(PP, Problem);
+    ctx->tree->SP = SP;
 
     // size of matrix L
     SP->n = num_vertices;
-    PP->n = SP->n;
 
-    // allocate memory for objective matrices for SP and PP
+    // allocate memory for objective matrix of SP
     alloc_matrix(SP->L, SP->n, double);
-    alloc_matrix(PP->L, SP->n, double);
 
     // IMPORTANT: last node is fixed to 0
     // --> BabPbSize is one less than the size of problem SP
-    BabPbSize = SP->n - 1; // num_vertices - 1;
+    ctx->tree->BabPbSize = SP->n - 1; // num_vertices - 1;
     
     /********** construct SP->L from Adj **********/
     /*
@@ -9,7 +9,7 @@
  * H is kxk matrix that determines k-gonal inequalities (pentagonal or heptagonal)
  * ineq stores the most violated k-gonal inequality
  */ 
-double qap_simulated_annealing(int *H, int k, double *X, int n, int *ineq) {
+double qap_simulated_annealing(const BiqBinContext *ctx, int *H, int k, double *X, int n, int *ineq) {
 
     /* parameters */
     int inner_iter = n;
@@ -65,7 +65,7 @@ double qap_simulated_annealing(int *H, int k, double *X, int n, int *ineq) {
 
     // b) from end till start do random transpositions of elements
     for (int i = n - 1; i > 0; --i) {
-        random_num = (rand() % i);
+        random_num = (Bab_random(ctx) % i);
         // swap entries in perm at position random_num i
         temp = perm[i];
         perm[i] = perm[random_num];
@@ -99,8 +99,8 @@ double qap_simulated_annealing(int *H, int k, double *X, int n, int *ineq) {
              * i1 in (0,...,k-1) and i2 (0,...,n-1) 
              * with i1 <= i2
              */
-            i1 = rand() % k;
-            i2 = rand() % n;
+            i1 = Bab_random(ctx) % k;
+            i2 = Bab_random(ctx) % n;
             if (i2 < i1) {
                 temp = i1;
                 i1 = i2;
@@ -136,7 +136,7 @@ double qap_simulated_annealing(int *H, int k, double *X, int n, int *ineq) {
                     accept = 0;
                 else {
                     prob = exp(-dt1);
-                    if ( ((double)rand()/((double)RAND_MAX)) < prob )
+                    if ( ((double)Bab_random(ctx)/((double)RAND_MAX)) < prob )
                         accept = 1;
                     else 
                         accept = 0;
@@ -13,6 +13,9 @@ class SerialBiqBinMaxCut:
         self.biqbin.compute.argtypes = [ctypes.POINTER(MaxCutInputData), BiqBinParameters]
         self.biqbin.compute.restype = ctypes.c_int
 
+        self.biqbin.compute_resume.argtypes = [ctypes.POINTER(MaxCutInputData), BiqBinParameters]
+        self.biqbin.compute_resume.restype = ctypes.c_int
+
         # Read parameters
         self.biqbin.readParameters.argtypes = [ctypes.c_char_p]
         self.biqbin.readParameters.restype = BiqBinParameters
@@ -25,6 +28,9 @@ class SerialBiqBinMaxCut:
 
     def compute(self, maxcut_data, params):
         return self.biqbin.compute(ctypes.pointer(maxcut_data), params)
+
+    def compute_resume(self, maxcut_data, params):
+        return self.biqbin.compute_resume(ctypes.pointer(maxcut_data), params)
     
     
     def read_maxcut_input(self, filename):
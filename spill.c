@@ -0,0 +1,347 @@
+/* Spill of open B&B nodes to a memory-mapped file on disk */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+
+#include "biqbin.h"
+
+/*
+ * When the open nodes use more memory than params.spill_memory, workers move nodes with
+ * the lowest priority from their heaps to the spill file (see heap.c). Nodes are stored
+ * in compact records:
+ *
+ *   upper_bound (double), branch_var (int32), branch_frac (float), xfixed and sol (words x uint64)
+ *
+ * Level of the node is the number of fixed variables and is not stored. Nodes spilled
+ * at once form a segment. Segments are loaded back (the one with the highest bound first)
+ * when a worker runs out of nodes or the spilled nodes have higher priority. The space of
+ * loaded and pruned segments becomes a hole that is reused by later segments (first fit);
+ * adjacent holes are merged and holes at the end of the file are dropped.
+ */
+
+#define RECORD_HEADER (sizeof(double) + sizeof(int32_t) + sizeof(float))
+
+
+/* size of the compact record of a node with words words per bitset (also used for checkpoints) */
+size_t nodeRecordSize(int words) {
+    return RECORD_HEADER + 2 * words * sizeof(uint64_t);
+}
+
+
+static inline size_t record_size(const SpillStore *store) {
+    return nodeRecordSize(store->words);
+}
+
+
+void packNode(char *rec, const BabNode *node) {
+
+    int32_t var = node->branch_var;
+
+    memcpy(rec, &node->upper_bound, sizeof(double));
+    memcpy(rec + sizeof(double), &var, sizeof(int32_t));
+    memcpy(rec + sizeof(double) + sizeof(int32_t), &node->branch_frac, sizeof(float));
+    memcpy(rec + RECORD_HEADER, node->bits, 2 * node->words * sizeof(uint64_t));
+}
+
+
+/* node must have been created with the same number of words as the packed node */
+void unpackNode(const char *rec, BabNode *node) {
+
+    int32_t var;
+
+    memcpy(&node->upper_bound, rec, sizeof(double));
+    memcpy(&var, rec + sizeof(double), sizeof(int32_t));
+    memcpy(&node->branch_frac, rec + sizeof(double) + sizeof(int32_t), sizeof(float));
+    memcpy(node->bits, rec + RECORD_HEADER, 2 * node->words * sizeof(uint64_t));
+
+    node->branch_var = var;
+    node->level = countFixedVariables(node);
+}
+
+
+/* highest bound of the segments (-BIG_NUMBER if there is none); store must be locked */
+static void update_top(SpillStore *store) {
+
+    double top = -BIG_NUMBER;
+
+    for (int s = 0; s < store->numSegments; ++s)
+        if (store->segments[s].bound > top)
+            top = store->segments[s].bound;
+
+    atomic_store(&store->top, top);
+}
+
+
+/* make the file (and mapping) at least size bytes long; store must be locked */
+static void spill_reserve(SpillStore *store, size_t size) {
+
+    if (size <= store->mapped)
+        return;
+
+    size_t new_size = (store->mapped > 0) ? store->mapped : (size_t) SPILL_BATCH * record_size(store) * 16;
+    while (new_size < size)
+        new_size *= 2;
+
+    if (store->map != NULL)
+        munmap(store->map, store->mapped);
+
+    if (ftruncate(store->fd, (off_t) new_size) != 0) {
+        fprintf(stderr, "Error: Cannot enlarge spill file to %zu bytes.\n", new_size);
+        exit(1);
+    }
+
+    store->map = (char *) mmap(NULL, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, store->fd, 0);
+    if (store->map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map spill file.\n");
+        exit(1);
+    }
+    store->mapped = new_size;
+}
+
+
+/* add space of size bytes at offset to the holes (merged with its neighbours); store must be locked */
+static void release_space(SpillStore *store, size_t offset, size_t size) {
+
+    int h = 0;
+
+    while (h < store->numHoles && store->holes[h].offset < offset)
+        ++h;
+
+    if (store->numHoles == store->maxHoles) {
+        store->maxHoles = (store->maxHoles > 0) ? 2 * store->maxHoles : 64;
+        store->holes = (SpillHole *) realloc(store->holes, store->maxHoles * sizeof(SpillHole));
+        if (store->holes == NULL) {
+            fprintf(stderr, "Error: Not enough memory for spill holes.\n");
+            exit(1);
+        }
+    }
+
+    memmove(&store->holes[h + 1], &store->holes[h], (store->numHoles - h) * sizeof(SpillHole));
+    store->holes[h] = (SpillHole) { offset, size };
+    ++store->numHoles;
+
+    // merge with the next and the previous hole
+    if (h + 1 < store->numHoles && offset + size == store->holes[h + 1].offset) {
+        store->holes[h].size += store->holes[h + 1].size;
+        memmove(&store->holes[h + 1], &store->holes[h + 2], (store->numHoles - h - 2) * sizeof(SpillHole));
+        --store->numHoles;
+    }
+    if (h > 0 && store->holes[h - 1].offset + store->holes[h - 1].size == offset) {
+        store->holes[h - 1].size += store->holes[h].size;
+        memmove(&store->holes[h], &store->holes[h + 1], (store->numHoles - h - 1) * sizeof(SpillHole));
+        --store->numHoles;
+    }
+
+    // a hole at the end of the file shortens the used part
+    SpillHole *last = &store->holes[store->numHoles - 1];
+    if (last->offset + last->size == store->end) {
+        store->end = last->offset;
+        --store->numHoles;
+    }
+}
+
+
+/* offset of size bytes of unused space: first hole that is large enough or the end of the file; store must be locked */
+static size_t reserve_space(SpillStore *store, size_t size) {
+
+    for (int h = 0; h < store->numHoles; ++h) {
+        SpillHole *hole = &store->holes[h];
+        if (hole->size >= size) {
+            size_t offset = hole->offset;
+            hole->offset += size;
+            hole->size -= size;
+            if (hole->size == 0) {
+                memmove(hole, hole + 1, (store->numHoles - h - 1) * sizeof(SpillHole));
+                --store->numHoles;
+            }
+            return offset;
+        }
+    }
+
+    spill_reserve(store, store->end + size);
+    store->end += size;
+
+    return store->end - size;
+}
+
+
+/* remove segment s and release its space; store must be locked */
+static void remove_segment(SpillStore *store, int s) {
+
+    SpillSegment seg = store->segments[s];
+
+    store->numNodes -= seg.count;
+    store->segments[s] = store->segments[--store->numSegments];
+
+    release_space(store, seg.offset, seg.count * record_size(store));
+}
+
+
+/* create spill file in $TMPDIR (or current directory); the file is removed when closed */
+void Spill_Init(BiqBinContext *ctx) {
+
+    BabTree *tree = ctx->tree;
+
+    if (tree->params.spill_memory <= 0)
+        return;
+
+    SpillStore *store;
+    alloc(store, SpillStore);
+
+    const char *dir = getenv("TMPDIR");
+    if (dir == NULL || dir[0] == '\0')
+        dir = ".";
+
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/biqbin_spill_XXXXXX", dir);
+
+    store->fd = mkstemp(path);
+    if (store->fd < 0) {
+        fprintf(stderr, "Error: Cannot create spill file in %s.\n", dir);
+        exit(1);
+    }
+    unlink(path);
+
+    store->words = BAB_WORDS(tree->BabPbSize);
+    store->map = NULL;
+    store->top = -BIG_NUMBER;
+    pthread_mutex_init(&store->lock, NULL);
+
+    tree->spill = store;
+}
+
+
+void Spill_Free(BiqBinContext *ctx) {
+
+    SpillStore *store = ctx->tree->spill;
+
+    if (store == NULL)
+        return;
+
+    if (store->map != NULL)
+        munmap(store->map, store->mapped);
+    close(store->fd);
+    pthread_mutex_destroy(&store->lock);
+    free(store->segments);
+    free(store->holes);
+    free(store);
+
+    ctx->tree->spill = NULL;
+}
+
+
+/* highest upper bound of the spilled nodes (-BIG_NUMBER if no node is spilled) */
+double Spill_TopBound(const BiqBinContext *ctx) {
+
+    if (ctx->tree->spill == NULL)
+        return -BIG_NUMBER;
+
+    return atomic_load(&ctx->tree->spill->top);
+}
+
+
+/* write count nodes to the spill file as one segment (nodes are not freed) */
+void Spill_Write(BiqBinContext *ctx, BabNode **nodes, int count) {
+
+    SpillStore *store = ctx->tree->spill;
+    size_t rs = record_size(store);
+    double bound = -BIG_NUMBER;
+
+    if (count == 0)
+        return;
+
+    pthread_mutex_lock(&store->lock);
+
+    size_t offset = reserve_space(store, count * rs);
+
+    for (int i = 0; i < count; ++i) {
+        packNode(store->map + offset + i * rs, nodes[i]);
+        if (nodes[i]->upper_bound > bound)
+            bound = nodes[i]->upper_bound;
+    }
+
+    if (store->numSegments == store->maxSegments) {
+        store->maxSegments = (store->maxSegments > 0) ? 2 * store->maxSegments : 64;
+        store->segments = (SpillSegment *) realloc(store->segments, store->maxSegments * sizeof(SpillSegment));
+        if (store->segments == NULL) {
+            fprintf(stderr, "Error: Not enough memory for spill segments.\n");
+            exit(1);
+        }
+    }
+    store->segments[store->numSegments++] = (SpillSegment) { bound, offset, count };
+    Checkpoint_LogRecords(ctx, store->map + offset, count);
+
+    store->numNodes += count;
+    store->totalSpilled += count;
+    if (store->numNodes > store->peakNodes)
+        store->peakNodes = store->numNodes;
+    if (store->end > store->peakBytes)
+        store->peakBytes = store->end;
+
+    if (bound > atomic_load(&store->top))
+        atomic_store(&store->top, bound);
+
+    pthread_mutex_unlock(&store->lock);
+}
+
+
+/*
+ * Load the segment with the highest bound into new nodes (at most SPILL_BATCH).
+ * Returns the number of loaded nodes.
+ */
+int Spill_Read(BiqBinContext *ctx, BabNode **nodes) {
+
+    SpillStore *store = ctx->tree->spill;
+    size_t rs = record_size(store);
+    int best = -1;
+    int count = 0;
+
+    pthread_mutex_lock(&store->lock);
+
+    for (int s = 0; s < store->numSegments; ++s)
+        if (best < 0 || store->segments[s].bound > store->segments[best].bound)
+            best = s;
+
+    if (best >= 0) {
+        SpillSegment *seg = &store->segments[best];
+
+        for (count = 0; count < seg->count; ++count) {
+            nodes[count] = newNode(ctx, NULL);
+            unpackNode(store->map + seg->offset + count * rs, nodes[count]);
+        }
+
+        remove_segment(store, best);
+        update_top(store);
+    }
+
+    pthread_mutex_unlock(&store->lock);
+
+    return count;
+}
+
+
+/* drop segments that cannot contain a better solution than lowerBound; returns the number of dropped nodes */
+int Spill_Prune(BiqBinContext *ctx, double lowerBound) {
+
+    SpillStore *store = ctx->tree->spill;
+    int pruned = 0;
+
+    if (store == NULL || atomic_load(&store->top) == -BIG_NUMBER)
+        return 0;
+
+    pthread_mutex_lock(&store->lock);
+
+    for (int s = store->numSegments - 1; s >= 0; --s) {
+        if (store->segments[s].bound <= lowerBound + 1.0) {
+            pruned += store->segments[s].count;
+            remove_segment(store, s);
+        }
+    }
+    update_top(store);
+
+    pthread_mutex_unlock(&store->lock);
+
+    return pruned;
+}
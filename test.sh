@@ -22,13 +22,18 @@ filter_out_root_node_bound_value() {
     sed 's/Root node bound = .*/Root node bound = /g'
 }
 
+# Filter out Estimated memory value.
+filter_out_memory_estimate_value() {
+    sed 's/Estimated memory = .*/Estimated memory = /g'
+}
+
 output=$($1 $2 $4) || exit $?
 # Filter out value which may vary due to randomnes.
-output_filtered=$(echo "$output" | filter_out_wall_time_line_value | filter_out_root_node_bound_value) || exit $?
+output_filtered=$(echo "$output" | filter_out_wall_time_line_value | filter_out_root_node_bound_value | filter_out_memory_estimate_value) || exit $?
 
 expected_output=$(cat $3) || exit $?
 # Filter out value which may vary due to randomnes.
-expected_output_filtered=$(echo "$expected_output" | filter_out_wall_time_line_value | filter_out_root_node_bound_value) || exit $?
+expected_output_filtered=$(echo "$expected_output" | filter_out_wall_time_line_value | filter_out_root_node_bound_value | filter_out_memory_estimate_value) || exit $?
 
 if [[ "$output_filtered" == "$expected_output_filtered" ]]; then
     echo "O.K."
@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# A test script for solver options: solves a problem instance with some parameters changed
+# and compares the optimum with the expected output of the default run.
+# Usage: ./test_options.sh biqbin instance expected_output params [--resume] [name=value ...]
+# With --resume the first run has to stop at time_limit, the second run continues from its checkpoint.
+# The script also checks that some options took effect: the second run resumed, nodes were spilled
+# (spill_memory > 0) and pool cuts were added to nodes (cut_pool > 0).
+
+set -e
+
+if [ "$#" -lt 4 ]; then
+    echo "Illegal number of parameters"
+    echo "Usage:"
+    echo "./test_options.sh biqbin instance expected_output params [--resume] [name=value ...]"
+    exit 1
+fi
+
+biqbin=$1
+instance=$2
+expected=$3
+params=$4
+shift 4
+
+resume=0
+if [ "$1" == "--resume" ]; then
+    resume=1
+    shift
+fi
+
+# Output and checkpoint files are written next to a copy of the instance.
+dir=$(mktemp -d)
+trap 'rm -rf "$dir"' EXIT
+cp "$instance" "$dir/instance"
+cp "$params" "$dir/params"
+echo >> "$dir/params"
+for option in "$@"; do
+    echo "$option" >> "$dir/params"
+done
+
+if [ $resume -eq 1 ]; then
+    $biqbin "$dir/instance" "$dir/params" > /dev/null || exit $?
+    if [ ! -f "$dir/instance.checkpoint" ]; then
+        echo "Failed! ($*)"
+        echo "No checkpoint was written."
+        exit 1
+    fi
+    echo "time_limit = 0" >> "$dir/params"
+    output=$($biqbin "$dir/instance" "$dir/params" --resume) || exit $?
+else
+    output=$($biqbin "$dir/instance" "$dir/params") || exit $?
+fi
+
+value=$(echo "$output" | grep "Maximum value") || true
+expected_value=$(grep "Maximum value" "$expected") || exit $?
+
+if [[ "$value" != "$expected_value" ]]; then
+    echo "Failed! ($*)"
+    echo "$value (expected: $expected_value)"
+    exit 1
+fi
+
+# statistics of all runs (the output file of a resumed run gets a suffix)
+stats=$(cat "$dir"/instance.output*)
+
+if [ $resume -eq 1 ] && ! echo "$output" | grep -q "Resumed from checkpoint"; then
+    echo "Failed! ($*)"
+    echo "The second run did not resume from the checkpoint."
+    exit 1
+fi
+
+for option in "$@"; do
+    name=${option%%=*}
+    number=${option#*=}
+    if [[ "$name" == "spill_memory" ]] && [[ "$number" != "0" ]] &&
+       ! echo "$stats" | grep -q "Spilled nodes = [1-9]"; then
+        echo "Failed! ($*)"
+        echo "No nodes were spilled."
+        exit 1
+    fi
+    if [[ "$name" == "cut_pool" ]] && [[ "$number" != "0" ]] &&
+       ! echo "$stats" | grep -q "probed, [1-9][0-9]* added"; then
+        echo "Failed! ($*)"
+        echo "No pool cuts were added to nodes."
+        exit 1
+    fi
+done
+
+echo "O.K. ($*)"